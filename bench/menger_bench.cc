@@ -0,0 +1,203 @@
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "camera.h"
+#include "menger.h"
+#include "obj_export.h"
+#include "raytracer.h"
+#include "bc1.h"
+#include "jpegio.h"
+
+namespace {
+	double g_min_seconds = 0.5;
+
+	// Runs body until at least g_min_seconds have passed and returns the
+	// seconds per call.
+	double measure(const std::function<void()>& body, long* iterations)
+	{
+		auto start = std::chrono::steady_clock::now();
+		double seconds = 0.0;
+		*iterations = 0;
+		while (seconds < g_min_seconds) {
+			body();
+			++*iterations;
+			seconds = std::chrono::duration<double>(
+					std::chrono::steady_clock::now() - start).count();
+		}
+		return seconds / *iterations;
+	}
+
+	void report(const char* name, const std::string& parameter,
+	            long iterations, double seconds, double work, const char* unit)
+	{
+		printf("%s,%s,%ld,%.9f,%.6g,%s\n", name, parameter.c_str(),
+		       iterations, seconds, work / seconds, unit);
+		fflush(stdout);
+	}
+
+	long cubes(int level)
+	{
+		long n = 1;
+		for (int i = 0; i < level; ++i)
+			n *= 20;
+		return n;
+	}
+
+	long file_size(const std::string& file)
+	{
+		FILE* f = fopen(file.c_str(), "rb");
+		if (!f)
+			return 0;
+		fseek(f, 0, SEEK_END);
+		long size = ftell(f);
+		fclose(f);
+		return size;
+	}
+};
+
+// CSV throughput of the sponge generator, the OBJ exporter, JPEG I/O, BC1
+// compression and the camera.
+// Usage: menger_bench [min_seconds] [max_level] [scratch_dir]
+int main(int argc, char* argv[])
+{
+	g_min_seconds = argc > 1 ? atof(argv[1]) : 0.5;
+	int max_level = argc > 2 ? atoi(argv[2]) : 4;
+	std::string scratch = argc > 3 ? argv[3] : ".";
+	printf("case,parameter,iterations,seconds_per_iteration,throughput,unit\n");
+
+	for (int level = 0; level <= max_level; ++level) {
+		Menger menger;
+		menger.set_nesting_level(level);
+		std::vector<glm::vec4> vertices, normals;
+		std::vector<glm::uvec3> faces;
+		long iterations = 0;
+		double seconds = measure([&]() {
+			vertices.clear();
+			faces.clear();
+			menger.generate_geometry(vertices, faces);
+		}, &iterations);
+		report("generate", "level" + std::to_string(level), iterations,
+		       seconds, cubes(level), "cubes/s");
+		seconds = measure([&]() {
+			vertices.clear();
+			normals.clear();
+			faces.clear();
+			menger.generate_geometry(vertices, normals, faces);
+		}, &iterations);
+		report("generate_normals", "level" + std::to_string(level),
+		       iterations, seconds, cubes(level), "cubes/s");
+
+		std::string file = scratch + "/menger_bench.obj";
+		seconds = measure([&]() {
+			SaveObj(file, vertices, faces);
+		}, &iterations);
+		report("save_obj", "level" + std::to_string(level), iterations,
+		       seconds, file_size(file) * 1e-6, "MB/s");
+		remove(file.c_str());
+	}
+
+	for (int size : { 256, 512, 1024, 2048 }) {
+		// A gradient with some noise, so the encoder has work to do.
+		std::vector<unsigned char> pixels(size * size * 3);
+		unsigned seed = 1;
+		for (size_t i = 0; i < pixels.size(); ++i) {
+			seed = seed * 1103515245 + 12345;
+			pixels[i] = (i / 3 % size + i / 3 / size) * 255 / (2 * size) +
+			            (seed >> 28);
+		}
+		std::string file = scratch + "/menger_bench.jpg";
+		std::string parameter = std::to_string(size) + "x" + std::to_string(size);
+		double megabytes = pixels.size() * 1e-6;
+		long iterations = 0;
+		double seconds = measure([&]() {
+			SaveJPEG(file, size, size, pixels.data(), 90);
+		}, &iterations);
+		report("save_jpeg", parameter, iterations, seconds, megabytes, "MB/s");
+		Image image;
+		seconds = measure([&]() {
+			LoadJPEG(file, &image);
+		}, &iterations);
+		report("load_jpeg", parameter, iterations, seconds, megabytes, "MB/s");
+		CompressedImage compressed;
+		seconds = measure([&]() {
+			CompressBC1(image, &compressed);
+		}, &iterations);
+		report("compress_bc1", parameter, iterations, seconds, megabytes, "MB/s");
+		seconds = measure([&]() {
+			LoadJPEG(file, &image, size / 4);
+		}, &iterations);
+		report("load_jpeg_quarter", parameter, iterations, seconds,
+		       megabytes, "MB/s");
+		remove(file.c_str());
+	}
+
+	// Points around the sponge, as the camera would ask about them.
+	std::vector<glm::vec3> points(1 << 20);
+	unsigned seed = 1;
+	for (auto& point : points) {
+		for (int i = 0; i < 3; ++i) {
+			seed = seed * 1103515245 + 12345;
+			point[i] = (seed >> 8) / float(1 << 24) * 1.2f - 0.6f;
+		}
+	}
+	long hits = 0;
+	for (int level = 0; level <= max_level * 2; ++level) {
+		Menger menger;
+		menger.set_nesting_level(level);
+		long iterations = 0;
+		double seconds = measure([&]() {
+			for (const auto& point : points)
+				hits += menger.contains(point);
+		}, &iterations);
+		report("contains", "level" + std::to_string(level), iterations,
+		       seconds, points.size(), "queries/s");
+		seconds = measure([&]() {
+			for (const auto& point : points)
+				hits += menger.intersects_sphere(point, 0.005f);
+		}, &iterations);
+		report("intersects_sphere", "level" + std::to_string(level),
+		       iterations, seconds, points.size(), "queries/s");
+	}
+
+	// Primary rays of the default view; run with OMP_NUM_THREADS from 1 up
+	// to see how the tiles scale.
+	for (int level = 1; level <= max_level + 1; ++level) {
+		RayTracer tracer(level, glm::vec4(-10.0f, 10.0f, 0.0f, 1.0f));
+		std::vector<unsigned char> pixels;
+		const int kWidth = 320, kHeight = 240;
+		long iterations = 0;
+		double seconds = measure([&]() {
+			tracer.render(Camera().get_view_matrix(), glm::radians(45.0f),
+			              kWidth, kHeight, 1, &pixels);
+		}, &iterations);
+		report("raytrace", "level" + std::to_string(level), iterations,
+		       seconds, kWidth * kHeight, "rays/s");
+	}
+
+	Camera camera;
+	const int kMatrices = 1024;
+	float checksum = 0.0f;
+	long iterations = 0;
+	double seconds = measure([&]() {
+		for (int i = 0; i < kMatrices; ++i) {
+			camera.rotate(1.0f, 0.5f);
+			checksum += camera.get_view_matrix()[3][0];
+		}
+	}, &iterations);
+	report("view_matrix", "rotate", iterations, seconds, kMatrices,
+	       "matrices/s");
+	seconds = measure([&]() {
+		for (int i = 0; i < kMatrices; ++i)
+			checksum += camera.get_view_matrix()[3][0];
+	}, &iterations);
+	report("view_matrix", "static", iterations, seconds, kMatrices,
+	       "matrices/s");
+	// Keeps the loops from being optimised away.
+	fprintf(stderr, "checksum %g %ld\n", checksum, hits);
+	return 0;
+}
@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ocean.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+	// vertexHeight, vertexNormal, tidalHeight and tidalNormal of
+	// ocean_geometry_shader, transcribed in double precision.
+	void reference(double x, double z, double t, double tidal_time,
+	               double* height, double normal[3])
+	{
+		*height = kOceanLevel;
+		double nx = 0.0, nz = 0.0;
+		for (const Wave& wave : kWaves) {
+			double phase = (wave.direction.x * x + wave.direction.y * z) *
+			               wave.frequency + t * wave.speed * wave.frequency;
+			*height += wave.amplitude * std::sin(phase);
+			double d = wave.frequency * wave.amplitude * std::cos(phase);
+			nx -= wave.direction.x * d;
+			nz -= wave.direction.y * d;
+		}
+		double px = x - tidal_time;
+		double w2 = double(kTidalWidth) * kTidalWidth;
+		double e = std::exp(-(px * px + z * z) / (2 * w2));
+		*height += kTidalHeight * e / (2 * 3.14159 * w2);
+		double d = kTidalHeight * -e / (2 * 3.14159 * w2 * w2);
+		nx -= px * d;
+		nz -= z * d;
+		double length = std::sqrt(nx * nx + 1.0 + nz * nz);
+		normal[0] = nx / length;
+		normal[1] = 1.0 / length;
+		normal[2] = nz / length;
+	}
+
+	// A grid over the ocean patch drawn by main.cc.
+	void fill_grid(OceanPoints* points, size_t count)
+	{
+		points->resize(count);
+		for (size_t i = 0; i < count; ++i) {
+			points->x[i] = -20.0f + 40.0f * (i % 1024) / 1024.0f;
+			points->z[i] = -20.0f + 40.0f * (i / 1024) / 1024.0f;
+		}
+	}
+
+	// Largest difference between EvaluateOcean and the reference over
+	// the points, at a few times as the waves and the tide move.
+	void check(OceanPoints* points)
+	{
+		double height_error = 0.0, normal_error = 0.0;
+		for (float t : { 0.0f, 1.5f, 10.0f }) {
+			EvaluateOcean(points, t, t - 1.0f);
+			for (size_t i = 0; i < points->size(); ++i) {
+				double height, normal[3];
+				reference(points->x[i], points->z[i], t, t - 1.0f, &height, normal);
+				height_error = std::max(height_error,
+						std::abs(points->height[i] - height));
+				normal_error = std::max(normal_error, std::max(
+						std::abs(points->normal_x[i] - normal[0]), std::max(
+						std::abs(points->normal_y[i] - normal[1]),
+						std::abs(points->normal_z[i] - normal[2]))));
+			}
+		}
+		printf("max error vs shader expressions: height %g, normal %g\n",
+		       height_error, normal_error);
+	}
+};
+
+// Points per second of EvaluateOcean for growing batch sizes.
+int main(int argc, char* argv[])
+{
+	double min_seconds = argc > 1 ? atof(argv[1]) : 0.5;
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	std::cout << "threads " << threads << "\n";
+
+	OceanPoints points;
+	fill_grid(&points, 1 << 16);
+	check(&points);
+
+	for (size_t count : { 1 << 6, 1 << 10, 1 << 14, 1 << 18, 1 << 20 }) {
+		OceanPoints points;
+		fill_grid(&points, count);
+
+		auto start = std::chrono::steady_clock::now();
+		double seconds = 0.0;
+		long evaluated = 0;
+		float t = 0.0f;
+		float checksum = 0.0f;
+		while (seconds < min_seconds) {
+			EvaluateOcean(&points, t, t - 1.0f);
+			checksum += points.height[count / 2];
+			evaluated += count;
+			t += 1.0f / 60.0f;
+			seconds = std::chrono::duration<double>(
+					std::chrono::steady_clock::now() - start).count();
+		}
+		printf("%8zu points  %8.2f Mpoints/s  (checksum %g)\n", count,
+		       evaluated / seconds * 1e-6, checksum);
+	}
+	return 0;
+}
@@ -0,0 +1,9 @@
+# EGL is optional, it provides the offscreen context of the -b benchmark.
+FIND_PACKAGE(PkgConfig REQUIRED)
+pkg_search_module(EGL egl)
+IF (EGL_FOUND)
+	ADD_DEFINITIONS(-DHAVE_EGL)
+	INCLUDE_DIRECTORIES(${EGL_INCLUDE_DIRS})
+	LIST(APPEND stdgl_libraries ${EGL_LIBRARIES})
+	message(STATUS "EGL_LIBRARIES=${EGL_LIBRARIES}")
+ENDIF()
@@ -6,7 +6,15 @@ set(EXECUTABLE_OUTPUT_PATH ${PROJECT_BINARY_DIR}/bin)
 
 # Flags
 #set(CMAKE_CXX_FLAGS "--std=c++14 -g -fmax-errors=1")
-set(CMAKE_CXX_FLAGS "--std=c++14 -g")
+set(CMAKE_CXX_FLAGS "--std=c++14")
+IF (NOT CMAKE_BUILD_TYPE)
+	SET(CMAKE_BUILD_TYPE Debug CACHE STRING "Debug, Release or RelWithDebInfo" FORCE)
+ENDIF ()
+# Release defines NDEBUG, which compiles the glGetError checks out of
+# CHECK_GL_ERROR.
+SET(CMAKE_CXX_FLAGS_DEBUG "-g")
+SET(CMAKE_CXX_FLAGS_RELEASE "-O2 -DNDEBUG")
+SET(CMAKE_CXX_FLAGS_RELWITHDEBINFO "-O2 -g -DNDEBUG")
 
 # Packages
 FIND_PACKAGE(OpenGL REQUIRED)
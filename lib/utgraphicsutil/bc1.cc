@@ -0,0 +1,205 @@
+#include "bc1.h"
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Gathers a 4x4 block as RGBX texels, 4 bytes each so 4 texels fill an
+// SSE register. Texels past the edges repeat the last row and column.
+void
+LoadBlock(const Image& image, int bx, int by, uint8_t* block)
+{
+	int stride = image.width * 3;
+	for (int y = 0; y < 4; ++y) {
+		int sy = std::min(by * 4 + y, image.height - 1);
+		const unsigned char* row = &image.bytes[sy * stride];
+		for (int x = 0; x < 4; ++x) {
+			int sx = std::min(bx * 4 + x, image.width - 1);
+			uint8_t* texel = &block[(y * 4 + x) * 4];
+			texel[0] = row[sx * 3 + 0];
+			texel[1] = row[sx * 3 + 1];
+			texel[2] = row[sx * 3 + 2];
+			texel[3] = 0;
+		}
+	}
+}
+
+// Per channel minimum and maximum of the 16 texels.
+void
+BlockBounds(const uint8_t* block, uint8_t* min, uint8_t* max)
+{
+#if defined(__SSE2__)
+	__m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+	__m128i hi = lo;
+	for (int i = 1; i < 4; ++i) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+		lo = _mm_min_epu8(lo, v);
+		hi = _mm_max_epu8(hi, v);
+	}
+	// Fold the four texels of each register into the first one.
+	lo = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+	lo = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+	hi = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 3, 2)));
+	hi = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1)));
+	int32_t packed = _mm_cvtsi128_si32(lo);
+	memcpy(min, &packed, 4);
+	packed = _mm_cvtsi128_si32(hi);
+	memcpy(max, &packed, 4);
+#else
+	memcpy(min, block, 4);
+	memcpy(max, block, 4);
+	for (int i = 1; i < 16; ++i) {
+		for (int c = 0; c < 4; ++c) {
+			min[c] = std::min(min[c], block[i * 4 + c]);
+			max[c] = std::max(max[c], block[i * 4 + c]);
+		}
+	}
+#endif
+}
+
+// dots[i] = texel i . direction
+void
+ProjectTexels(const uint8_t* block, const int* direction, int32_t* dots)
+{
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i d = _mm_setr_epi16(direction[0], direction[1], direction[2], 0,
+	                                 direction[0], direction[1], direction[2], 0);
+	for (int i = 0; i < 4; ++i) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+		// Two texels per register: r*dr + g*dg and b*db for each.
+		__m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(v, zero), d);
+		__m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(v, zero), d);
+		lo = _mm_add_epi32(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+		hi = _mm_add_epi32(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1)));
+		__m128i sums = _mm_unpacklo_epi64(
+				_mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 3, 2, 0)),
+				_mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 3, 2, 0)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dots + 4 * i), sums);
+	}
+#else
+	for (int i = 0; i < 16; ++i)
+		dots[i] = block[i * 4] * direction[0] + block[i * 4 + 1] * direction[1] +
+		          block[i * 4 + 2] * direction[2];
+#endif
+}
+
+uint16_t
+To565(const int* color)
+{
+	return ((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3);
+}
+
+// Widens with the top bits repeated, as the decoder does.
+void
+From565(uint16_t value, int* color)
+{
+	int r = (value >> 11) & 31, g = (value >> 5) & 63, b = value & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+void
+EncodeBlock(const uint8_t* block, unsigned char* out)
+{
+	uint8_t min[4], max[4];
+	BlockBounds(block, min, max);
+
+	// The box's main diagonal runs from min to max. When red or blue fall
+	// as green rises, the colors follow another diagonal, so swap the
+	// ends of that channel.
+	int mid[3], cov_rg = 0, cov_bg = 0;
+	for (int c = 0; c < 3; ++c)
+		mid[c] = (min[c] + max[c] + 1) / 2;
+	for (int i = 0; i < 16; ++i) {
+		int g = block[i * 4 + 1] - mid[1];
+		cov_rg += (block[i * 4] - mid[0]) * g;
+		cov_bg += (block[i * 4 + 2] - mid[2]) * g;
+	}
+	// Pulling the ends in by 1/16 of the range lowers the average error.
+	int lo[3], hi[3];
+	for (int c = 0; c < 3; ++c) {
+		int inset = (max[c] - min[c]) >> 4;
+		lo[c] = min[c] + inset;
+		hi[c] = max[c] - inset;
+	}
+	if (cov_rg < 0)
+		std::swap(lo[0], hi[0]);
+	if (cov_bg < 0)
+		std::swap(lo[2], hi[2]);
+
+	// color0 > color1 selects the four color mode.
+	uint16_t color0 = To565(hi), color1 = To565(lo);
+	if (color0 < color1)
+		std::swap(color0, color1);
+	uint32_t indices = 0;
+	if (color0 != color1) {
+		int p0[3], p1[3], direction[3];
+		From565(color0, p0);
+		From565(color1, p1);
+		for (int c = 0; c < 3; ++c)
+			direction[c] = p1[c] - p0[c];
+		int32_t dots[16];
+		ProjectTexels(block, direction, dots);
+		int start = p0[0] * direction[0] + p0[1] * direction[1] + p0[2] * direction[2];
+		int length = direction[0] * direction[0] + direction[1] * direction[1] +
+		             direction[2] * direction[2];
+		// Thirds of the way from color0 to color1, and their codes.
+		static const uint32_t kCodes[4] = { 0, 2, 3, 1 };
+		for (int i = 0; i < 16; ++i) {
+			int step = ((dots[i] - start) * 6 + length) / (2 * length);
+			step = std::min(std::max(step, 0), 3);
+			indices |= kCodes[step] << (2 * i);
+		}
+	}
+
+	out[0] = color0 & 0xff;
+	out[1] = color0 >> 8;
+	out[2] = color1 & 0xff;
+	out[3] = color1 >> 8;
+	for (int i = 0; i < 4; ++i)
+		out[4 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+};
+
+void
+CompressBC1(const Image& image, CompressedImage* out)
+{
+	out->width = image.width;
+	out->height = image.height;
+	out->bytes.clear();
+	if (image.width <= 0 || image.height <= 0 || image.bytes.empty())
+		return;
+	int blocks_x = (image.width + 3) / 4;
+	int blocks_y = (image.height + 3) / 4;
+	out->bytes.resize(size_t(blocks_x) * blocks_y * 8);
+
+	#pragma omp parallel for schedule(static) if (blocks_y > 1)
+	for (int by = 0; by < blocks_y; ++by) {
+		uint8_t block[64];
+		for (int bx = 0; bx < blocks_x; ++bx) {
+			LoadBlock(image, bx, by, block);
+			EncodeBlock(block, &out->bytes[(size_t(by) * blocks_x + bx) * 8]);
+		}
+	}
+}
+
+void
+CompressCubemapBC1(const Image* faces, const std::vector<Image>* chains,
+                   std::vector<CompressedImage>* out)
+{
+	// The levels are encoded one after another, each over all threads, as
+	// the base levels hold nearly all the work.
+	for (int f = 0; f < 6; ++f) {
+		out[f].resize(chains[f].size() + 1);
+		CompressBC1(faces[f], &out[f][0]);
+		for (size_t level = 0; level < chains[f].size(); ++level)
+			CompressBC1(chains[f][level], &out[f][level + 1]);
+	}
+}
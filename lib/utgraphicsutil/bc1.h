@@ -0,0 +1,40 @@
+#ifndef BC1_H
+#define BC1_H
+
+#include <vector>
+#include "image.h"
+
+// GL_COMPRESSED_RGB_S3TC_DXT1_EXT, for headers without the extension.
+const unsigned int kBC1Format = 0x83F0;
+
+/*
+ * An image in BC1 (DXT1) blocks, ready for glCompressedTexImage2D.
+ * Every 4x4 texels take 8 bytes: two RGB565 end points and a 2 bit index
+ * per texel into the four colors evenly spaced between them. Blocks are
+ * stored in rows, top to bottom in the same order as the source rows.
+ */
+struct CompressedImage {
+	std::vector<unsigned char> bytes;
+	int width;
+	int height;
+};
+
+/*
+ * Compresses an Image with tightly packed GL_RGB rows, as from LoadJPEG or
+ * GenerateMipChain. The end points are the corners of the block's color
+ * bounding box, pulled in by 1/16 and flipped along the diagonal the
+ * colors follow (J.M.P. van Waveren, "Real-Time DXT Compression"). Blocks
+ * are encoded in parallel with SSE2 where available. Partial blocks at the
+ * right and bottom edges repeat the last texels.
+ */
+void CompressBC1(const Image& image, CompressedImage* out);
+
+/*
+ * Compresses the six faces and their mip chains. faces and chains must
+ * point to six elements, and out[f] gets face f followed by its chain.
+ */
+void CompressCubemapBC1(const Image* faces,
+                        const std::vector<Image>* chains,
+                        std::vector<CompressedImage>* out);
+
+#endif
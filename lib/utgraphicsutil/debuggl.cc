@@ -1,6 +1,83 @@
+#include <GL/glew.h>
 #include "debuggl.h"
-#include <portable_gl.h>
 #include <GLFW/glfw3.h>
+#include <cstdlib>
+#include <iostream>
+
+thread_local const char* g_debuggl_function = "";
+thread_local int g_debuggl_line = 0;
+
+namespace {
+	bool abort_enabled = false;
+	bool synchronous_enabled = false;
+
+	const char* source_to_string(GLenum source)
+	{
+		switch (source) {
+			case GL_DEBUG_SOURCE_API:
+				return "api";
+			case GL_DEBUG_SOURCE_WINDOW_SYSTEM:
+				return "window system";
+			case GL_DEBUG_SOURCE_SHADER_COMPILER:
+				return "shader compiler";
+			case GL_DEBUG_SOURCE_THIRD_PARTY:
+				return "third party";
+			case GL_DEBUG_SOURCE_APPLICATION:
+				return "application";
+			default:
+				return "other";
+		}
+	}
+
+	const char* type_to_string(GLenum type)
+	{
+		switch (type) {
+			case GL_DEBUG_TYPE_ERROR:
+				return "error";
+			case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
+				return "deprecated";
+			case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
+				return "undefined behavior";
+			case GL_DEBUG_TYPE_PORTABILITY:
+				return "portability";
+			case GL_DEBUG_TYPE_PERFORMANCE:
+				return "performance";
+			case GL_DEBUG_TYPE_MARKER:
+				return "marker";
+			default:
+				return "other";
+		}
+	}
+
+	const char* severity_to_string(GLenum severity)
+	{
+		switch (severity) {
+			case GL_DEBUG_SEVERITY_HIGH:
+				return "high";
+			case GL_DEBUG_SEVERITY_MEDIUM:
+				return "medium";
+			case GL_DEBUG_SEVERITY_LOW:
+				return "low";
+			default:
+				return "notification";
+		}
+	}
+
+	void GLAPIENTRY
+	message_callback(GLenum source, GLenum type, GLuint id, GLenum severity,
+	                 GLsizei length, const GLchar* message, const void* user)
+	{
+		if (severity == GL_DEBUG_SEVERITY_NOTIFICATION)
+			return;
+		if (synchronous_enabled && g_debuggl_line > 0)
+			std::cerr << g_debuggl_function << " Line :" << g_debuggl_line << " ";
+		std::cerr << "OpenGL Debug (" << severity_to_string(severity) << ", "
+		          << source_to_string(source) << " " << type_to_string(type)
+		          << " " << id << "): " << message << "\n";
+		if (type == GL_DEBUG_TYPE_ERROR && abort_enabled)
+			abort();
+	}
+};
 
 const char* DebugGLErrorToString(int error) {
 	switch (error) {
@@ -30,3 +107,19 @@ void debugglTerminate()
 {
 	glfwTerminate();
 }
+
+bool DebugGLEnableOutput(bool synchronous, bool abort_on_error)
+{
+	if (!GLEW_VERSION_4_3 && !GLEW_KHR_debug)
+		return false;
+	abort_enabled = abort_on_error;
+	synchronous_enabled = synchronous;
+	glDebugMessageCallback(message_callback, nullptr);
+	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+	if (synchronous)
+		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	else
+		glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	glEnable(GL_DEBUG_OUTPUT);
+	return true;
+}
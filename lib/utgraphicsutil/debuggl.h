@@ -3,6 +3,26 @@
 
 void debugglTerminate();
 
+/*
+ * Call site of the last CHECK_GL_ERROR on this thread, in every build.
+ * Messages from the KHR_debug callback report it when output is
+ * synchronous, as the callback then runs inside the failing call.
+ * Asynchronous messages may arrive late or on another thread, so they
+ * carry no location.
+ */
+extern thread_local const char* g_debuggl_function;
+extern thread_local int g_debuggl_line;
+
+/*
+ * Installs a GL_KHR_debug message callback that prints errors and warnings
+ * to stderr with their source, type and id. Synchronous output attributes
+ * messages to the right call site at some cost in speed. If abort_on_error
+ * is set, GL errors abort() so a debugger stops on them, inside the failing
+ * call if output is synchronous. Returns false if the context lacks
+ * KHR_debug.
+ */
+bool DebugGLEnableOutput(bool synchronous, bool abort_on_error);
+
 #define CHECK_SUCCESS(x)   \
   do {                     \
     if (!(x)) {            \
@@ -46,8 +66,23 @@ void debugglTerminate();
     }                                                                        \
   } while (0)
 
+#ifdef NDEBUG
+/*
+ * glGetError can stall the pipeline, so release builds only record the call
+ * site and leave error reporting to DebugGLEnableOutput. The stores go to
+ * thread-local variables and cost next to nothing.
+ */
 #define CHECK_GL_ERROR(statement)                                             \
   do {                                                                        \
+    g_debuggl_function = __func__;                                            \
+    g_debuggl_line = __LINE__;                                                \
+    { statement; }                                                            \
+  } while (0)
+#else
+#define CHECK_GL_ERROR(statement)                                             \
+  do {                                                                        \
+    g_debuggl_function = __func__;                                            \
+    g_debuggl_line = __LINE__;                                                \
     { statement; }                                                            \
     GLenum error = GL_NO_ERROR;                                               \
     if ((error = glGetError()) != GL_NO_ERROR) {                              \
@@ -57,6 +92,7 @@ void debugglTerminate();
       exit(EXIT_FAILURE);                                                     \
     }                                                                         \
   } while (0)
+#endif
 
 const char* DebugGLErrorToString(int error);
 
@@ -0,0 +1,15 @@
+#include <GL/glew.h>
+#include "gl_util.h"
+#include <cstring>
+
+bool HasGLExtension(const char* name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; ++i) {
+		const GLubyte* extension = glGetStringi(GL_EXTENSIONS, i);
+		if (extension && strcmp(reinterpret_cast<const char*>(extension), name) == 0)
+			return true;
+	}
+	return false;
+}
@@ -0,0 +1,7 @@
+#ifndef GL_UTIL_H
+#define GL_UTIL_H
+
+// True if the current context lists the extension in GL_EXTENSIONS.
+bool HasGLExtension(const char* name);
+
+#endif
@@ -6,7 +6,8 @@
 bool SaveJPEG(const std::string& filename,
               int image_width,
               int image_height,
-              const unsigned char* pixels)
+              const unsigned char* pixels,
+              int quality)
 {
 	struct jpeg_compress_struct cinfo;
 	struct jpeg_error_mgr jerr;
@@ -18,8 +19,10 @@ bool SaveJPEG(const std::string& filename,
 	jpeg_create_compress(&cinfo);
 
 	outfile = fopen(filename.c_str(), "wb");
-	if (outfile == NULL)
+	if (outfile == NULL) {
+		jpeg_destroy_compress(&cinfo);
 		return false;
+	}
 
 	jpeg_stdio_dest(&cinfo, outfile);
 
@@ -28,7 +31,7 @@ bool SaveJPEG(const std::string& filename,
 	cinfo.input_components = 3;
 	cinfo.in_color_space = JCS_RGB;
 	jpeg_set_defaults(&cinfo);
-	jpeg_set_quality(&cinfo, 100, (boolean)true);
+	jpeg_set_quality(&cinfo, quality, (boolean)true);
 	jpeg_start_compress(&cinfo, (boolean)true);
 
 	row_stride = image_width * 3;
@@ -46,7 +49,7 @@ bool SaveJPEG(const std::string& filename,
 	return true;
 }
 
-bool LoadJPEG(const std::string& file_name, Image* image)
+bool LoadJPEG(const std::string& file_name, Image* image, int max_size)
 {
 	FILE* file = fopen(file_name.c_str(), "rb");
 	struct jpeg_decompress_struct info;
@@ -55,15 +58,26 @@ bool LoadJPEG(const std::string& file_name, Image* image)
 	info.err = jpeg_std_error(&err);
 	jpeg_create_decompress(&info);
 
-	if (file == NULL)
+	if (file == NULL) {
+		jpeg_destroy_decompress(&info);
 		return false;
+	}
 
 	jpeg_stdio_src(&info, file);
 	jpeg_read_header(&info, (boolean)true);
+	if (max_size > 0) {
+		unsigned int denom = 1;
+		while (denom < 8 && (info.image_width > max_size * denom ||
+		                     info.image_height > max_size * denom))
+			denom *= 2;
+		info.scale_num = 1;
+		info.scale_denom = denom;
+	}
 	jpeg_start_decompress(&info);
 
 	image->width = info.output_width;
 	image->height = info.output_height;
+	image->stride = image->width * 3;
 
 	int channels = info.num_components;
 	long size = image->width * image->height * 3;
@@ -86,6 +100,7 @@ bool LoadJPEG(const std::string& file_name, Image* image)
 		out_scan_line += image->width * 3;
 	}
 	jpeg_finish_decompress(&info);
+	jpeg_destroy_decompress(&info);
 	fclose(file);
 	return true;
 }
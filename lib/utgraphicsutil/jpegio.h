@@ -4,10 +4,18 @@
 #include <string>
 #include "image.h"
 
+// pixels are GL_RGB rows stored bottom-up, as returned by glReadPixels.
 bool SaveJPEG(const std::string& filename,
               int image_width,
               int image_height,
-              const unsigned char* pixels);
-bool LoadJPEG(const std::string& file_name, Image* image);
+              const unsigned char* pixels,
+              int quality = 100);
+/*
+ * If max_size is positive the image is decoded at 1/2, 1/4 or 1/8 of its
+ * size, whichever is the largest that fits in max_size x max_size (or 1/8
+ * if none does). The scaling happens in the DCT domain, so decode time and
+ * memory shrink with the output size.
+ */
+bool LoadJPEG(const std::string& file_name, Image* image, int max_size = 0);
 
 #endif
@@ -0,0 +1,194 @@
+#include "mipmap.h"
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+	// Kaiser filter parameters, in destination texels. A 2:1 reduction
+	// therefore touches 4 * kKaiserWidth source texels per axis.
+	const int kKaiserWidth = 3;
+	const float kKaiserAlpha = 4.0f;
+	const int kKaiserTaps = 4 * kKaiserWidth;
+	const float kPi = 3.14159265358979f;
+
+// Modified Bessel function of the first kind, order 0.
+float
+Bessel0(float x)
+{
+	float sum = 1.0f;
+	float term = 1.0f;
+	float half = 0.5f * x;
+	for (int k = 1; k < 32; ++k) {
+		term *= (half / k) * (half / k);
+		sum += term;
+		if (term < sum * 1e-7f)
+			break;
+	}
+	return sum;
+}
+
+float
+KaiserWeight(float x)
+{
+	if (std::abs(x) >= kKaiserWidth)
+		return 0.0f;
+	float t = x / kKaiserWidth;
+	float window = Bessel0(kKaiserAlpha * std::sqrt(1.0f - t * t)) / Bessel0(kKaiserAlpha);
+	float sinc = (x == 0.0f) ? 1.0f : std::sin(kPi * x) / (kPi * x);
+	return sinc * window;
+}
+
+// Tap k reads source texel 2 * x + k - kKaiserTaps / 2 + 1 for destination
+// texel x. The weights are the same for every texel of a 2:1 reduction.
+void
+KaiserTaps(float* weights)
+{
+	float sum = 0.0f;
+	for (int k = 0; k < kKaiserTaps; ++k) {
+		float offset = (k - kKaiserTaps / 2 + 1) - 0.5f;
+		weights[k] = KaiserWeight(0.5f * offset);
+		sum += weights[k];
+	}
+	for (int k = 0; k < kKaiserTaps; ++k)
+		weights[k] /= sum;
+}
+
+// out[i] = a[i] + b[i]
+void
+SumRows(const unsigned char* a, const unsigned char* b, uint16_t* out, int n)
+{
+	int i = 0;
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= n; i += 16) {
+		__m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+		__m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+		__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+		__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), lo);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8), hi);
+	}
+#endif
+	for (; i < n; ++i)
+		out[i] = a[i] + b[i];
+}
+
+// out[i] += weight * in[i]
+void
+AccumulateRow(const unsigned char* in, float weight, float* out, int n)
+{
+	int i = 0;
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 w = _mm_set1_ps(weight);
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+		__m128i lo = _mm_unpacklo_epi8(v, zero);
+		__m128i hi = _mm_unpackhi_epi8(v, zero);
+		__m128i quads[4] = {
+			_mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+			_mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero)
+		};
+		for (int q = 0; q < 4; ++q) {
+			__m128 acc = _mm_loadu_ps(out + i + 4 * q);
+			acc = _mm_add_ps(acc, _mm_mul_ps(_mm_cvtepi32_ps(quads[q]), w));
+			_mm_storeu_ps(out + i + 4 * q, acc);
+		}
+	}
+#endif
+	for (; i < n; ++i)
+		out[i] += weight * in[i];
+}
+
+void
+DownsampleBox(const Image& src, Image* dst)
+{
+	int row = src.width * 3;
+	std::vector<uint16_t> sums(row);
+	for (int y = 0; y < dst->height; ++y) {
+		int y0 = std::min(2 * y, src.height - 1);
+		int y1 = std::min(2 * y + 1, src.height - 1);
+		SumRows(&src.bytes[y0 * row], &src.bytes[y1 * row], sums.data(), row);
+
+		unsigned char* out = &dst->bytes[y * dst->width * 3];
+		for (int x = 0; x < dst->width; ++x) {
+			int x0 = std::min(2 * x, src.width - 1) * 3;
+			int x1 = std::min(2 * x + 1, src.width - 1) * 3;
+			for (int c = 0; c < 3; ++c)
+				out[3 * x + c] = (sums[x0 + c] + sums[x1 + c] + 2) >> 2;
+		}
+	}
+}
+
+void
+DownsampleKaiser(const Image& src, Image* dst, const float* weights)
+{
+	int row = src.width * 3;
+	std::vector<float> column(row);
+	for (int y = 0; y < dst->height; ++y) {
+		// Vertical pass into a float row, then the horizontal pass from it.
+		std::fill(column.begin(), column.end(), 0.0f);
+		for (int k = 0; k < kKaiserTaps; ++k) {
+			int sy = std::min(std::max(2 * y + k - kKaiserTaps / 2 + 1, 0), src.height - 1);
+			AccumulateRow(&src.bytes[sy * row], weights[k], column.data(), row);
+		}
+
+		unsigned char* out = &dst->bytes[y * dst->width * 3];
+		for (int x = 0; x < dst->width; ++x) {
+			float sum[3] = { 0.0f, 0.0f, 0.0f };
+			for (int k = 0; k < kKaiserTaps; ++k) {
+				int sx = std::min(std::max(2 * x + k - kKaiserTaps / 2 + 1, 0), src.width - 1);
+				for (int c = 0; c < 3; ++c)
+					sum[c] += weights[k] * column[3 * sx + c];
+			}
+			for (int c = 0; c < 3; ++c)
+				out[3 * x + c] = static_cast<unsigned char>(
+						std::min(std::max(sum[c] + 0.5f, 0.0f), 255.0f));
+		}
+	}
+}
+
+};
+
+void
+GenerateMipChain(const Image& base, std::vector<Image>* levels, MipFilter filter)
+{
+	levels->clear();
+	if (base.bytes.empty() || base.width <= 0 || base.height <= 0)
+		return;
+
+	int count = 0;
+	for (int size = std::max(base.width, base.height); size > 1; size /= 2)
+		++count;
+	// Each level is built from the previous one, so keep them from moving.
+	levels->reserve(count);
+
+	float weights[kKaiserTaps];
+	KaiserTaps(weights);
+
+	const Image* src = &base;
+	for (int i = 0; i < count; ++i) {
+		Image dst;
+		dst.width = std::max(1, src->width / 2);
+		dst.height = std::max(1, src->height / 2);
+		dst.stride = dst.width * 3;
+		dst.bytes.resize(dst.stride * dst.height);
+		if (filter == kMipFilterKaiser)
+			DownsampleKaiser(*src, &dst, weights);
+		else
+			DownsampleBox(*src, &dst);
+		levels->push_back(std::move(dst));
+		src = &levels->back();
+	}
+}
+
+void
+GenerateCubemapMipChains(const Image* faces, std::vector<Image>* chains, MipFilter filter)
+{
+	#pragma omp parallel for
+	for (int i = 0; i < 6; ++i)
+		GenerateMipChain(faces[i], &chains[i], filter);
+}
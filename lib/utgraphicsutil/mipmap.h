@@ -0,0 +1,32 @@
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include <vector>
+#include "image.h"
+
+enum MipFilter {
+	kMipFilterBox,    // 2x2 average, cheapest.
+	kMipFilterKaiser, // Kaiser-windowed sinc, sharper and less aliasing.
+};
+
+/*
+ * Builds the mip chain of base, excluding base itself.
+ * levels[0] is half the size of base (rounded down, at least 1x1), and the
+ * chain ends with a 1x1 image. All images are in the same GL_RGB layout as
+ * Image with tightly packed rows, so set GL_UNPACK_ALIGNMENT to 1 before
+ * uploading them. A base without pixels, e.g. one that failed to load,
+ * gets an empty chain.
+ */
+void GenerateMipChain(const Image& base,
+                      std::vector<Image>* levels,
+                      MipFilter filter = kMipFilterBox);
+
+/*
+ * Same as GenerateMipChain for the six faces of a cubemap, one face per
+ * thread. faces and chains must both point to six elements.
+ */
+void GenerateCubemapMipChains(const Image* faces,
+                              std::vector<Image>* chains,
+                              MipFilter filter = kMipFilterBox);
+
+#endif
@@ -1,4 +1,7 @@
 #include "camera.h"
+#include "menger.h"
+#include <algorithm>
+#include <cmath>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/rotate_vector.hpp>
 #include "glm/ext.hpp"
@@ -9,20 +12,25 @@ namespace {
 	float roll_speed = 0.1f;
 	float rotation_speed = 0.05f;
 	float zoom_speed = 0.1f;
+	// Steps of the search for how far a blocked move can go.
+	int collision_steps = 8;
 };
 
 void Camera::strafe_tangent(int direction) {
-	eye_ += direction * pan_speed *
-	        glm::normalize(glm::cross(look_, up_)); // tangent
+	move_eye(eye_ + direction * pan_speed *
+	         glm::normalize(glm::cross(look_, up_))); // tangent
+	dirty_ = true;
 }
 
 void Camera::strafe_up(int direction) {
-	eye_ += direction * pan_speed *
-	        glm::normalize(glm::cross(glm::normalize(glm::cross(look_, up_)), look_)); // recomputed up
+	move_eye(eye_ + direction * pan_speed *
+	         glm::normalize(glm::cross(glm::normalize(glm::cross(look_, up_)), look_))); // recomputed up
+	dirty_ = true;
 }
 
 void Camera::strafe_forward(int direction){
-	eye_ += direction * zoom_speed * look_;
+	move_eye(eye_ + direction * zoom_speed * look_);
+	dirty_ = true;
 }
 
 void Camera::zoom(int direction) {
@@ -31,13 +39,55 @@ void Camera::zoom(int direction) {
 	if(camera_distance_ <= 0.01f){
 		camera_distance_ = 0.01f;
 	}
-	eye_ = center - camera_distance_ * look_;
-	
+	glm::vec3 target = center - camera_distance_ * look_;
+	move_eye(target);
+	if (eye_ != target)
+		camera_distance_ = glm::length(center - eye_);
+	dirty_ = true;
+}
+
+void Camera::set_collider(const Menger* menger, float radius) {
+	collider_ = menger;
+	collider_radius_ = radius;
+}
+
+// Goes as far towards target as the collider allows. The path is checked
+// every radius, so thin walls cannot be stepped over. An eye that is
+// already stuck moves freely, so it can get out.
+void Camera::move_eye(const glm::vec3& target) {
+	if (!collider_ || collider_radius_ <= 0.0f ||
+	    collider_->intersects_sphere(eye_, collider_radius_)) {
+		eye_ = target;
+		return;
+	}
+	float length = glm::length(target - eye_);
+	int samples = std::max(1, int(std::ceil(length / collider_radius_)));
+	float free = 0.0f, blocked = 0.0f;
+	for (int i = 1; i <= samples && blocked == 0.0f; ++i) {
+		float t = float(i) / samples;
+		if (collider_->intersects_sphere(glm::mix(eye_, target, t), collider_radius_))
+			blocked = t;
+		else
+			free = t;
+	}
+	if (blocked == 0.0f) {
+		eye_ = target;
+		return;
+	}
+	for (int i = 0; i < collision_steps; ++i) {
+		float t = 0.5f * (free + blocked);
+		if (collider_->intersects_sphere(glm::mix(eye_, target, t), collider_radius_))
+			blocked = t;
+		else
+			free = t;
+	}
+	eye_ = glm::mix(eye_, target, free);
 }
 
 void Camera::roll(int direction) {
 	up_ = glm::rotate(up_, roll_speed * direction, -look_);
 	// up_ = glm::cos(roll_speed * direction) * up_ + glm::sin(roll_speed * direction) * glm::normalize(glm::cross(look_, up_));
+	dirty_ = true;
 }
 
 void Camera::rotate(float dx, float dy){
@@ -56,9 +106,50 @@ void Camera::rotate(float dx, float dy){
 		look_ = -glm::normalize(eye_rel_cent);
 		up_ = glm::normalize(glm::rotate(up_, rotation_speed, norm));
 	}
+	dirty_ = true;
+}
 
+void Camera::save_state(std::ostream& out) const {
+	std::streamsize precision = out.precision(9);
+	out << camera_distance_ << ' ' << fps;
+	for (const glm::vec3& v : { look_, up_, eye_ })
+		out << ' ' << v.x << ' ' << v.y << ' ' << v.z;
+	out.precision(precision);
 }
+
+// Only the saved fields change, e.g. the collider stays.
+bool Camera::load_state(std::istream& in) {
+	float camera_distance = 0.0f;
+	bool fps_mode = true;
+	glm::vec3 look, up, eye;
+	in >> camera_distance >> fps_mode;
+	for (glm::vec3* v : { &look, &up, &eye })
+		in >> v->x >> v->y >> v->z;
+	if (!in)
+		return false;
+	camera_distance_ = camera_distance;
+	fps = fps_mode;
+	look_ = look;
+	up_ = up;
+	eye_ = eye;
+	dirty_ = true;
+	return true;
+}
+
+bool Camera::is_dirty() const {
+	return dirty_;
+}
+
+void Camera::set_clean() {
+	dirty_ = false;
+}
+
 // FIXME: Calculate the view matrix
+glm::vec3 Camera::get_eye_position() const
+{
+	return eye_;
+}
+
 glm::mat4 Camera::get_view_matrix() const
 {
 	glm::vec3 tangent = glm::normalize(glm::cross(look_, up_));
@@ -2,10 +2,14 @@
 #define CAMERA_H
 
 #include <glm/glm.hpp>
+#include <iosfwd>
+
+class Menger;
 
 class Camera {
 public:
 	glm::mat4 get_view_matrix() const;
+	glm::vec3 get_eye_position() const;
 	// FIXME: add functions to manipulate camera objects.
 	void strafe_tangent(int direction);
 	void strafe_up(int direction);
@@ -13,14 +17,30 @@ public:
 	void zoom(int direction);
 	void roll(int direction);
 	void rotate(float dx, float dy);
+	// Whole camera as one line of text, exact enough to replay a session.
+	void save_state(std::ostream& out) const;
+	bool load_state(std::istream& in);
+	// Strafing and zooming stop the eye short of the sponge's solid, keeping
+	// a sphere of radius around it free. Null, or a radius of 0 or less, lets
+	// the eye go anywhere.
+	void set_collider(const Menger* menger, float radius);
+	// True once the view changed since the last set_clean().
+	bool is_dirty() const;
+	void set_clean();
 	float last_y = 0.0f;
 	float last_x = 0.0f;
 	bool fps = true;
 private:
+	void move_eye(const glm::vec3& target);
+
+
 	float camera_distance_ = 10.0f * glm::sqrt(2.0f);
 	glm::vec3 look_ = glm::normalize(glm::vec3(0.0f, -10.0f, -10.0f));
 	glm::vec3 up_ = glm::vec3(0.0f, 1.0f, 0.0f);
 	glm::vec3 eye_ = glm::vec3(0, 10.0f, 10.0f);
+	bool dirty_ = true;
+	const Menger* collider_ = nullptr;
+	float collider_radius_ = 0.0f;
 	// Note: you may need additional member variables
 };
 
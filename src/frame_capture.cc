@@ -0,0 +1,118 @@
+#include "frame_capture.h"
+#include <debuggl.h>
+#include <algorithm>
+#include <iostream>
+#include <stdio.h>
+
+#include "../lib/utgraphicsutil/jpegio.h"
+
+FrameCapture::FrameCapture(const std::string& prefix, int quality,
+                           int ring_size, int num_threads)
+	: prefix_(prefix), quality_(quality), slots_(ring_size),
+	  max_jobs_(4 * num_threads)
+{
+	for (auto& slot : slots_)
+		CHECK_GL_ERROR(glGenBuffers(1, &slot.pbo));
+	for (int i = 0; i < num_threads; ++i)
+		workers_.emplace_back(&FrameCapture::encode_loop, this);
+}
+
+FrameCapture::~FrameCapture()
+{
+	flush();
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	job_ready_.notify_all();
+	for (auto& worker : workers_)
+		worker.join();
+	for (auto& slot : slots_)
+		glDeleteBuffers(1, &slot.pbo);
+}
+
+void
+FrameCapture::capture(int width, int height)
+{
+	Slot& slot = slots_[next_slot_];
+	next_slot_ = (next_slot_ + 1) % slots_.size();
+	if (slot.pending)
+		collect(slot);
+
+	CHECK_GL_ERROR(glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo));
+	if (slot.width != width || slot.height != height) {
+		CHECK_GL_ERROR(glBufferData(GL_PIXEL_PACK_BUFFER, width * height * 3,
+					nullptr, GL_STREAM_READ));
+		slot.width = width;
+		slot.height = height;
+	}
+	CHECK_GL_ERROR(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+	CHECK_GL_ERROR(glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, 0));
+	CHECK_GL_ERROR(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+	slot.index = next_index_++;
+	slot.pending = true;
+}
+
+void
+FrameCapture::flush()
+{
+	// Oldest first, so frames reach the encoders in order.
+	for (size_t i = 0; i < slots_.size(); ++i) {
+		Slot& slot = slots_[(next_slot_ + i) % slots_.size()];
+		if (slot.pending)
+			collect(slot);
+	}
+}
+
+void
+FrameCapture::collect(Slot& slot)
+{
+	Job job;
+	job.width = slot.width;
+	job.height = slot.height;
+	job.index = slot.index;
+	job.pixels.resize(slot.width * slot.height * 3);
+
+	CHECK_GL_ERROR(glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo));
+	const void* mapped = nullptr;
+	CHECK_GL_ERROR(mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+				job.pixels.size(), GL_MAP_READ_BIT));
+	if (mapped) {
+		std::copy(static_cast<const unsigned char*>(mapped),
+		          static_cast<const unsigned char*>(mapped) + job.pixels.size(),
+		          job.pixels.begin());
+		CHECK_GL_ERROR(glUnmapBuffer(GL_PIXEL_PACK_BUFFER));
+	}
+	CHECK_GL_ERROR(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+	slot.pending = false;
+	if (!mapped)
+		return;
+
+	// Only wait when the encoders have fallen behind.
+	std::unique_lock<std::mutex> lock(mutex_);
+	job_taken_.wait(lock, [this] { return jobs_.size() < max_jobs_; });
+	jobs_.push_back(std::move(job));
+	lock.unlock();
+	job_ready_.notify_one();
+}
+
+void
+FrameCapture::encode_loop()
+{
+	while (true) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		job_ready_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+		if (jobs_.empty())
+			return;
+		Job job = std::move(jobs_.front());
+		jobs_.pop_front();
+		lock.unlock();
+		job_taken_.notify_one();
+
+		char number[16];
+		snprintf(number, sizeof(number), "%06d", job.index);
+		std::string file = prefix_ + number + ".jpg";
+		if (!SaveJPEG(file, job.width, job.height, job.pixels.data(), quality_))
+			std::cerr << "Failed to write " << file << "\n";
+	}
+}
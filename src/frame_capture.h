@@ -0,0 +1,61 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <GL/glew.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Records the framebuffer as numbered JPEG files without stalling the GPU.
+ *
+ * capture() starts an asynchronous glReadPixels into one slot of a ring of
+ * pixel buffer objects, and maps the slot filled ring_size frames earlier,
+ * which the GPU has finished by then. The pixels are handed to a pool of
+ * threads that encode them with SaveJPEG.
+ */
+class FrameCapture {
+public:
+	FrameCapture(const std::string& prefix, int quality = 90,
+	             int ring_size = 3, int num_threads = 2);
+	~FrameCapture();
+	// Call after drawing and before swapping buffers.
+	void capture(int width, int height);
+	// Collects every frame still in flight, e.g. when recording stops.
+	void flush();
+private:
+	struct Slot {
+		GLuint pbo = 0;
+		int width = 0;
+		int height = 0;
+		int index = 0;
+		bool pending = false;
+	};
+	struct Job {
+		std::vector<unsigned char> pixels;
+		int width;
+		int height;
+		int index;
+	};
+	void collect(Slot& slot);
+	void encode_loop();
+
+	std::string prefix_;
+	int quality_;
+	std::vector<Slot> slots_;
+	size_t next_slot_ = 0;
+	int next_index_ = 0;
+
+	std::vector<std::thread> workers_;
+	std::deque<Job> jobs_;
+	size_t max_jobs_;
+	std::mutex mutex_;
+	std::condition_variable job_ready_;
+	std::condition_variable job_taken_;
+	bool stopping_ = false;
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <glm/glm.hpp>
+
+// Uniform buffer binding point of the Frame block, shared by every program.
+const unsigned int kFrameUniformBinding = 0;
+
+/*
+ * Per-frame values every program needs. Filled once per frame on the CPU
+ * and uploaded as one std140 uniform block, so no shader has to invert
+ * the view matrix itself.
+ *
+ * Must match FRAME_UNIFORM_BLOCK member for member.
+ */
+struct FrameUniforms {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 inverse_view;
+	glm::mat4 view_projection;
+	glm::mat4 light_view_projection;
+	glm::vec4 eye_position;
+	glm::vec4 light_position;
+	glm::vec4 viewport; // width, height, 0, 0 in pixels
+	float time;
+	float padding[3];
+};
+
+// GLSL declaration of the block, spliced into shader sources right after
+// their #version line.
+#define FRAME_UNIFORM_BLOCK \
+"layout(std140) uniform Frame {\n" \
+"	mat4 view;\n" \
+"	mat4 projection;\n" \
+"	mat4 inverse_view;\n" \
+"	mat4 view_projection;\n" \
+"	mat4 light_view_projection;\n" \
+"	vec4 eye_position;\n" \
+"	vec4 light_position;\n" \
+"	vec4 viewport;\n" \
+"	float time;\n" \
+"};\n"
+
+#endif
@@ -0,0 +1,118 @@
+#include "gpu_timer.h"
+#include <algorithm>
+#include <debuggl.h>
+#include <iostream>
+
+GpuTimer::GpuTimer(const std::vector<std::string>& passes, int window)
+	: passes_(passes), window_(window), samples_(passes.size()),
+	  next_sample_(passes.size(), 0)
+{
+	for (int b = 0; b < 2; ++b) {
+		queries_[b].resize(passes_.size());
+		issued_[b].assign(passes_.size(), false);
+		CHECK_GL_ERROR(glGenQueries(queries_[b].size(), queries_[b].data()));
+	}
+}
+
+GpuTimer::~GpuTimer()
+{
+	for (int b = 0; b < 2; ++b)
+		glDeleteQueries(queries_[b].size(), queries_[b].data());
+}
+
+void
+GpuTimer::set_enabled(bool enabled)
+{
+	if (enabled && !enabled_) {
+		// Start over, old samples would skew the first report.
+		for (int b = 0; b < 2; ++b)
+			issued_[b].assign(passes_.size(), false);
+		for (size_t p = 0; p < passes_.size(); ++p) {
+			samples_[p].clear();
+			next_sample_[p] = 0;
+		}
+		frame_ = 0;
+	}
+	enabled_ = enabled;
+}
+
+bool
+GpuTimer::enabled() const
+{
+	return enabled_;
+}
+
+void
+GpuTimer::begin(int pass)
+{
+	if (!enabled_)
+		return;
+	CHECK_GL_ERROR(glBeginQuery(GL_TIME_ELAPSED, queries_[buffer_][pass]));
+	issued_[buffer_][pass] = true;
+}
+
+void
+GpuTimer::end(int pass)
+{
+	if (!enabled_)
+		return;
+	CHECK_GL_ERROR(glEndQuery(GL_TIME_ELAPSED));
+}
+
+void
+GpuTimer::end_frame(std::ostream& out)
+{
+	if (!enabled_)
+		return;
+	buffer_ ^= 1;
+	collect(buffer_);
+	if (++frame_ % window_ == 0)
+		report(out);
+}
+
+void
+GpuTimer::collect(int buffer)
+{
+	for (size_t p = 0; p < passes_.size(); ++p) {
+		if (!issued_[buffer][p])
+			continue;
+		issued_[buffer][p] = false;
+		GLint available = GL_FALSE;
+		CHECK_GL_ERROR(glGetQueryObjectiv(queries_[buffer][p],
+					GL_QUERY_RESULT_AVAILABLE, &available));
+		if (!available)
+			continue;
+		GLuint64 ns = 0;
+		CHECK_GL_ERROR(glGetQueryObjectui64v(queries_[buffer][p],
+					GL_QUERY_RESULT, &ns));
+		float ms = ns * 1e-6f;
+		if (samples_[p].size() < window_)
+			samples_[p].push_back(ms);
+		else
+			samples_[p][next_sample_[p]] = ms;
+		next_sample_[p] = (next_sample_[p] + 1) % window_;
+	}
+}
+
+void
+GpuTimer::report(std::ostream& out)
+{
+	if (!header_written_) {
+		out << "frame,pass,samples,min_ms,avg_ms,p99_ms\n";
+		header_written_ = true;
+	}
+	for (size_t p = 0; p < passes_.size(); ++p) {
+		std::vector<float> sorted = samples_[p];
+		if (sorted.empty())
+			continue;
+		std::sort(sorted.begin(), sorted.end());
+		float sum = 0.0f;
+		for (float ms : sorted)
+			sum += ms;
+		size_t p99 = std::min(sorted.size() - 1, sorted.size() * 99 / 100);
+		out << frame_ << "," << passes_[p] << "," << sorted.size() << ","
+		    << sorted.front() << "," << sum / sorted.size() << ","
+		    << sorted[p99] << "\n";
+	}
+	out.flush();
+}
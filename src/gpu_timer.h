@@ -0,0 +1,49 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <GL/glew.h>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+ * GPU time of each render pass, measured with GL_TIME_ELAPSED queries.
+ *
+ * Every pass has two query objects used on alternate frames, and a query
+ * is only read back when its frame comes around again, one frame after it
+ * was issued. A result that is still not available by then is dropped, so
+ * the CPU never waits on the GPU.
+ *
+ * The last window samples of each pass are kept, and every window frames
+ * their min, average and 99th percentile are written as CSV lines.
+ */
+class GpuTimer {
+public:
+	GpuTimer(const std::vector<std::string>& passes, int window = 120);
+	~GpuTimer();
+	void set_enabled(bool enabled);
+	bool enabled() const;
+	// Passes must not nest, GL allows one GL_TIME_ELAPSED query at a time.
+	void begin(int pass);
+	void end(int pass);
+	// Call once per frame after the last pass.
+	void end_frame(std::ostream& out);
+	// Writes the current statistics right away.
+	void report(std::ostream& out);
+private:
+	void collect(int buffer);
+
+	std::vector<std::string> passes_;
+	size_t window_;
+	bool enabled_ = false;
+	bool header_written_ = false;
+	int buffer_ = 0;
+	int frame_ = 0;
+	std::vector<GLuint> queries_[2];
+	std::vector<bool> issued_[2];
+	// Rolling window of milliseconds per pass.
+	std::vector<std::vector<float>> samples_;
+	std::vector<size_t> next_sample_;
+};
+
+#endif
@@ -0,0 +1,131 @@
+#include "headless.h"
+#include <debuggl.h>
+#include <iostream>
+
+#ifdef HAVE_EGL
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+namespace {
+	EGLDisplay surfaceless_display()
+	{
+		auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+				eglGetProcAddress("eglGetPlatformDisplayEXT"));
+		EGLDisplay display = EGL_NO_DISPLAY;
+		if (get_platform_display)
+			display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+					EGL_DEFAULT_DISPLAY, nullptr);
+		if (display == EGL_NO_DISPLAY)
+			display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		return display;
+	}
+};
+
+HeadlessContext::HeadlessContext(int width, int height, bool debug)
+{
+	EGLDisplay display = surfaceless_display();
+	EGLint major = 0, minor = 0;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+		std::cerr << "No EGL display\n";
+		return;
+	}
+	display_ = display;
+
+	const EGLint config_attributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config = nullptr;
+	EGLint num_configs = 0;
+	eglChooseConfig(display, config_attributes, &config, 1, &num_configs);
+	eglBindAPI(EGL_OPENGL_API);
+	const EGLint context_attributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 1,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_CONTEXT_FLAGS_KHR, debug ? EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR : 0,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display,
+			num_configs ? config : EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT,
+			context_attributes);
+	if (context == EGL_NO_CONTEXT) {
+		std::cerr << "Failed to create an EGL context: 0x" << std::hex
+		          << eglGetError() << std::dec << "\n";
+		return;
+	}
+	context_ = context;
+	if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		std::cerr << "EGL_KHR_surfaceless_context is not supported\n";
+		return;
+	}
+
+	// glewInit also wants a GLX display, the GL entry points are enough.
+	glewExperimental = GL_TRUE;
+	if (glewContextInit() != GLEW_OK) {
+		std::cerr << "Failed to load GL entry points\n";
+		return;
+	}
+	glGetError();
+
+	CHECK_GL_ERROR(glGenRenderbuffers(2, renderbuffers_));
+	CHECK_GL_ERROR(glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers_[0]));
+	CHECK_GL_ERROR(glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height));
+	CHECK_GL_ERROR(glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers_[1]));
+	CHECK_GL_ERROR(glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height));
+	CHECK_GL_ERROR(glGenFramebuffers(1, &framebuffer_));
+	CHECK_GL_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_));
+	CHECK_GL_ERROR(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+				GL_RENDERBUFFER, renderbuffers_[0]));
+	CHECK_GL_ERROR(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+				GL_RENDERBUFFER, renderbuffers_[1]));
+	GLenum status = GL_FRAMEBUFFER_COMPLETE;
+	CHECK_GL_ERROR(status = glCheckFramebufferStatus(GL_FRAMEBUFFER));
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr << "Offscreen framebuffer incomplete: " << status << "\n";
+		return;
+	}
+	valid_ = true;
+}
+
+HeadlessContext::~HeadlessContext()
+{
+	if (!display_)
+		return;
+	if (context_) {
+		if (framebuffer_)
+			glDeleteFramebuffers(1, &framebuffer_);
+		if (renderbuffers_[0])
+			glDeleteRenderbuffers(2, renderbuffers_);
+		eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(display_, context_);
+	}
+	eglTerminate(display_);
+}
+
+#else
+
+HeadlessContext::HeadlessContext(int width, int height, bool debug)
+{
+	std::cerr << "Built without EGL, no headless context\n";
+}
+
+HeadlessContext::~HeadlessContext()
+{
+}
+
+#endif
+
+bool
+HeadlessContext::is_valid() const
+{
+	return valid_;
+}
+
+GLuint
+HeadlessContext::framebuffer() const
+{
+	return framebuffer_;
+}
@@ -0,0 +1,32 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <GL/glew.h>
+
+/*
+ * OpenGL 4.1 core context without a window or display, for benchmarks on
+ * machines with no GPU, e.g. Mesa llvmpipe on CI.
+ *
+ * The context comes from EGL on the surfaceless platform and renders into
+ * a framebuffer object of the given size, which stays bound as the target
+ * of every draw. There is no swap and so no vsync.
+ *
+ * Only available when CMake found EGL, see cmake/egl.cmake.
+ */
+class HeadlessContext {
+public:
+	// debug requests a debug context, for DebugGLEnableOutput.
+	HeadlessContext(int width, int height, bool debug = false);
+	~HeadlessContext();
+	// False if no context could be created, the reason went to stderr.
+	bool is_valid() const;
+	GLuint framebuffer() const;
+private:
+	void* display_ = nullptr;
+	void* context_ = nullptr;
+	GLuint framebuffer_ = 0;
+	GLuint renderbuffers_[2] = { 0, 0 };
+	bool valid_ = false;
+};
+
+#endif
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -18,21 +21,50 @@
 
 
 #include "menger.h"
+#include "menger_gpu.h"
+#include "mesh_optimizer.h"
 #include "camera.h"
-
+#include "frame_capture.h"
+#include "frame_uniforms.h"
+#include "gpu_timer.h"
+#include "headless.h"
+#include "obj_export.h"
+#include "ocean.h"
+#include "ocean_clipmap.h"
+#include "ocean_fft.h"
+#include "program_cache.h"
+#include "raytracer.h"
+#include "render_queue.h"
+#include "replay.h"
+#include "shadow_map.h"
+#include "sponge_field.h"
+
+#include "../lib/utgraphicsutil/bc1.h"
+#include "../lib/utgraphicsutil/gl_util.h"
 #include "../lib/utgraphicsutil/image.h"
 #include "../lib/utgraphicsutil/jpegio.h"
+#include "../lib/utgraphicsutil/mipmap.h"
 
 #define BILLION  1000000000L
 
 int window_width = 800, window_height = 600;
 
+// Shared by the raster path and the ray tracer.
+const glm::vec4 kLightPosition(-10.0f, 10.0f, 0.0f, 1.0f);
+const float kFieldOfView = 45.0f; // vertical, in degrees
+// Room kept between the eye and the sponge, under the smallest level 4
+// holes but far past the near plane.
+const float kCameraRadius = 0.005f;
+
 // VBO and VAO descriptors.
-enum { kVertexBuffer, kIndexBuffer, kNumVbos };
+enum { kVertexBuffer, kNormalBuffer, kIndexBuffer, kNumVbos };
 
 // These are our VAOs.
 enum { kGeometryVao, kFloorVao, kOceanVao, kSkyboxVao, kNumVaos };
 
+// Render passes timed by GpuTimer.
+enum { kShadowPass, kSkyboxPass, kSpongePass, kFloorPass, kOceanPass, kFieldPass, kNumPasses };
+
 GLuint g_array_objects[kNumVaos];  // This will store the VAO descriptors.
 GLuint g_buffer_objects[kNumVaos][kNumVbos];  // These will store VBO descriptors.
 
@@ -40,9 +72,7 @@ GLuint g_buffer_objects[kNumVaos][kNumVbos];  // These will store VBO descriptor
 // See http://en.cppreference.com/w/cpp/language/string_literal
 const char* vertex_shader =
 R"zzz(#version 400 core
-in vec4 vertex_position;
-uniform mat4 view;
-uniform vec4 light_position;
+)zzz" FRAME_UNIFORM_BLOCK R"zzz(in vec4 vertex_position;
 out vec4 vs_light_direction;
 out vec4 vs_world_pos;
 void main()
@@ -53,12 +83,78 @@ void main()
 }
 )zzz";
 
+// Ocean vertex shader. Positions are in clipmap grid units, see
+// OceanClipmap, and the world position is passed on for the TCS.
+const char* ocean_vertex_shader =
+R"zzz(#version 400 core
+)zzz" FRAME_UNIFORM_BLOCK R"zzz(in vec4 vertex_position;
+uniform vec4 ring;
+out vec4 vs_light_direction;
+out vec4 vs_world_pos;
+void main()
+{
+	vec2 xz = ring.xy + vertex_position.xz * ring.z;
+	vs_world_pos = vec4(xz.x, vertex_position.y, xz.y, 1.0f);
+	gl_Position = view * vs_world_pos;
+	vs_light_direction = -gl_Position + view * light_position;
+}
+)zzz";
+
+// Sponge vertex shader for the path without a geometry shader. The face
+// normal comes from the provoking (last) vertex, see Menger::generate_geometry.
+const char* flat_vertex_shader =
+R"zzz(#version 400 core
+)zzz" FRAME_UNIFORM_BLOCK R"zzz(in vec4 vertex_position;
+in vec4 vertex_normal;
+flat out vec4 normal;
+out vec4 light_direction;
+void main()
+{
+	gl_Position = view_projection * vertex_position;
+	normal = view * vertex_normal;
+	light_direction = view * (light_position - vertex_position);
+}
+)zzz";
+
+// Flat sponge vertex shader for SpongeField, placing each instance with
+// its own transform.
+const char* instanced_vertex_shader =
+R"zzz(#version 400 core
+)zzz" FRAME_UNIFORM_BLOCK R"zzz(in vec4 vertex_position;
+in vec4 vertex_normal;
+in mat4 instance_transform;
+flat out vec4 normal;
+out vec4 light_direction;
+void main()
+{
+	vec4 world_position = instance_transform * vertex_position;
+	gl_Position = view_projection * world_position;
+	normal = view * normalize(instance_transform * vertex_normal);
+	light_direction = view * (light_position - world_position);
+}
+)zzz";
+
+// Depth-only pass of the sponge into the shadow map.
+const char* shadow_vertex_shader =
+R"zzz(#version 400 core
+)zzz" FRAME_UNIFORM_BLOCK R"zzz(in vec4 vertex_position;
+void main()
+{
+	gl_Position = light_view_projection * vertex_position;
+}
+)zzz";
+
+const char* shadow_fragment_shader =
+R"zzz(#version 400 core
+void main()
+{
+}
+)zzz";
+
 const char* geometry_shader =
 R"zzz(#version 400 core
-layout (triangles) in;
+)zzz" FRAME_UNIFORM_BLOCK R"zzz(layout (triangles) in;
 layout (triangle_strip, max_vertices = 3) out;
-uniform mat4 projection;
-uniform mat4 view;
 in vec4 vs_light_direction[];
 flat out vec4 normal;
 flat out vec4 gs_vert_pos[3];
@@ -71,13 +167,13 @@ void main()
 	// size = gl_in[1].gl_Position.xyz - gl_in[0].gl_Position.xyz;
 	normal = normalize(vec4(cross(gl_in[1].gl_Position.xyz - gl_in[0].gl_Position.xyz, gl_in[2].gl_Position.xyz - gl_in[0].gl_Position.xyz), 0.0f));
 	for (n = 0; n < gl_in.length(); n++) {
-		gs_vert_pos[n] = inverse(view) * gl_in[n].gl_Position;
+		gs_vert_pos[n] = inverse_view * gl_in[n].gl_Position;
 		vec3 temp = vec3(0.0f, 0.0f, 0.0f);
 		temp[n] = 1.0f;
 		bary = temp;
 		light_direction = vs_light_direction[n];
 		gl_Position = projection * gl_in[n].gl_Position;
-		world_position = inverse(view) * gl_in[n].gl_Position;
+		world_position = inverse_view * gl_in[n].gl_Position;
 		EmitVertex();
 	}
 	EndPrimitive();
@@ -86,13 +182,12 @@ void main()
 
 const char* fragment_shader =
 R"zzz(#version 400 core
-flat in vec4 normal;
-uniform mat4 view;
+)zzz" FRAME_UNIFORM_BLOCK R"zzz(flat in vec4 normal;
 in vec4 light_direction;
 out vec4 fragment_color;
 void main()
 {
-	vec4 world_normal = inverse(view) * normal;
+	vec4 world_normal = inverse_view * normal;
 	vec4 color = vec4(abs(world_normal.xyz), 1.0);
 	float dot_nl = dot(normalize(light_direction), normalize(normal));
 	dot_nl = clamp(dot_nl, 0.0, 1.0);
@@ -103,13 +198,12 @@ void main()
 // FIXME: Implement shader effects with an alternative shader.
 const char* floor_fragment_shader =
 R"zzz(#version 400 core
-flat in vec4 normal;
+)zzz" FRAME_UNIFORM_BLOCK SHADOW_MAP_LOOKUP R"zzz(flat in vec4 normal;
 flat in vec4 gs_vert_pos[3];
 in vec4 light_direction;
 in vec4 world_position;
 in vec3 bary;
 uniform bool wireframe;
-uniform vec4 light_position;
 out vec4 fragment_color;
 
 float distToLine(vec4 p, vec4 l1, vec4 l2){
@@ -134,20 +228,7 @@ void main()
 		float dot_nl = dot(normalize(light_direction), normalize(normal));
 		dot_nl = clamp(dot_nl, 0.0, 1.0);
 		vec4 tempColor = clamp(dot_nl * color, 0.0, 1.0);
-
-		vec4 lightToWorld = normalize(world_position - light_position);
-		float denTop = dot(lightToWorld.xyz, vec3(0, 1.0f, 0));
-		float denSide = dot(lightToWorld.xyz, vec3(1.0f, 0, 0));
-		if(denTop != 0 && denSide != 0) {
-			float tTop = dot(vec3(0, .5f, 0) - light_position.xyz, vec3(0, 1.0f, 0)) / denTop;
-			float tSide = dot(vec3(-.5f, 0, 0) - light_position.xyz, vec3(1.0f, 0, 0)) / denSide;
-			
-			vec4 intersectTop = light_position + tTop * lightToWorld;
-			vec4 intersectSide = light_position + tSide * lightToWorld;
-			if((abs(intersectTop.x) < .5f && abs(intersectTop.z) < .5f) || (abs(intersectSide.y) < .5f && abs(intersectSide.z) < .5f)) {
-				tempColor *= .4f;
-			}
-		}
+		tempColor *= mix(.4f, 1.0f, shadow(world_position));
 		fragment_color = tempColor;
 	}
 }
@@ -186,40 +267,131 @@ void main()
 }
 )zzz";
 
+// Levels follow the on-screen size of the patch, tess_level_* segments per
+// 64 pixels, and patches outside the view frustum are dropped.
+//
+// Where two clipmap rings meet, one coarse edge borders two fine ones. The
+// coarse edge gets an even level computed from its own end points and each
+// fine half exactly half of it, so the vertices line up and no T-junction
+// cracks open.
 const char* ocean_tesscontrol_shader =
 R"zzz(#version 400 core
-layout (vertices = 4) out;
+)zzz" FRAME_UNIFORM_BLOCK R"zzz(layout (vertices = 4) out;
 in vec4 vs_light_direction[];
+in vec4 vs_world_pos[];
 uniform float tess_level_inner;
 uniform float tess_level_outer;
-uniform float tidal_start_time;
-uniform float time;
-uniform mat4 view;
+uniform vec2 wave_margin;
+uniform vec4 ring;
+uniform vec3 ring_inner;
 out vec4 tcs_light_direction[];
+
+// Pixels covered by a sphere around the edge. It only depends on the two
+// end points, so neighbouring patches agree on shared edges and no cracks
+// open between them.
+float edgePixels(vec3 a, vec3 b)
+{
+	float diameter = distance(a, b);
+	float d = max(distance(0.5f * (a + b), eye_position.xyz), 1e-3f);
+	return diameter * projection[1][1] * 0.5f * viewport.y / d;
+}
+
+// True if the edge a-b lies on the square of half size r around c.
+bool onSquare(vec3 a, vec3 b, vec2 c, float r)
+{
+	float eps = 0.25f * ring.z;
+	vec2 da = abs(abs(a.xz - c) - r);
+	vec2 db = abs(abs(b.xz - c) - r);
+	return (da.x < eps && db.x < eps) || (da.y < eps && db.y < eps);
+}
+
+// True if the patch, grown by how far the waves can move it, is entirely
+// outside one of the clip planes.
+bool culled()
+{
+	vec3 lo = vec3(1e30f);
+	vec3 hi = vec3(-1e30f);
+	for (int i = 0; i < 4; i++) {
+		vec3 p = vs_world_pos[i].xyz;
+		lo = min(lo, p);
+		hi = max(hi, p);
+	}
+	vec3 margin = wave_margin.xyx;
+	lo -= margin;
+	hi += margin;
+	ivec3 below = ivec3(0);
+	ivec3 above = ivec3(0);
+	for (int i = 0; i < 8; i++) {
+		vec3 corner = mix(lo, hi, vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1));
+		vec4 clip = view_projection * vec4(corner, 1.0f);
+		below += ivec3(lessThan(clip.xyz, vec3(-clip.w)));
+		above += ivec3(greaterThan(clip.xyz, vec3(clip.w)));
+	}
+	return any(equal(below, ivec3(8))) || any(equal(above, ivec3(8)));
+}
+
+float level(float pixels, float scale)
+{
+	return clamp(pixels * scale / 64.0f, 1.0f, 64.0f);
+}
+
+float edgeLevel(int i, int j)
+{
+	vec3 a = vs_world_pos[i].xyz;
+	vec3 b = vs_world_pos[j].xyz;
+	float s = ring.z;
+	if (ring.w > 0.0f && onSquare(a, b, ring.xy, 4.0f * s)) {
+		// Half of an edge of the next ring out. Its end points sit on
+		// multiples of twice our patch size.
+		vec3 lo = min(a, b);
+		lo.xz = floor(lo.xz / (2.0f * s) + 0.25f) * (2.0f * s);
+		vec3 hi = lo + 2.0f * abs(b - a);
+		return ceil(0.5f * level(edgePixels(lo, hi), tess_level_outer));
+	}
+	if (ring_inner.z > 0.0f && onSquare(a, b, ring_inner.xy, 2.0f * s))
+		return 2.0f * ceil(0.5f * level(edgePixels(a, b), tess_level_outer));
+	return level(edgePixels(a, b), tess_level_outer);
+}
+
 void main()
 {
 	gl_out[gl_InvocationID].gl_Position = gl_in[gl_InvocationID].gl_Position;
 	tcs_light_direction[gl_InvocationID] = vs_light_direction[gl_InvocationID];
 	if(gl_InvocationID == 0){
-		vec4 avg = (gl_in[0].gl_Position + gl_in[1].gl_Position + gl_in[2].gl_Position + gl_in[3].gl_Position) * .25f;
-		vec4 distance = view * vec4(time - tidal_start_time, -2.0f, 0.0f, 1.0f);
-		float d = length(avg - distance);
-		float adapt = clamp(7 - d, 1.0f, 6.0f);
-		gl_TessLevelInner[0] = tess_level_inner * adapt;
-		gl_TessLevelInner[1] = tess_level_inner * adapt;
-		gl_TessLevelOuter[0] = tess_level_outer * adapt;
-		gl_TessLevelOuter[1] = tess_level_outer * adapt;
-		gl_TessLevelOuter[2] = tess_level_outer * adapt;
-		gl_TessLevelOuter[3] = tess_level_outer * adapt;
+		if(culled()) {
+			gl_TessLevelOuter[0] = 0.0f;
+			gl_TessLevelOuter[1] = 0.0f;
+			gl_TessLevelOuter[2] = 0.0f;
+			gl_TessLevelOuter[3] = 0.0f;
+			gl_TessLevelInner[0] = 0.0f;
+			gl_TessLevelInner[1] = 0.0f;
+			return;
+		}
+		// Edges u = 0, v = 0, u = 1 and v = 1, see ocean_tesseval_shader.
+		gl_TessLevelOuter[0] = edgeLevel(0, 3);
+		gl_TessLevelOuter[1] = edgeLevel(0, 1);
+		gl_TessLevelOuter[2] = edgeLevel(1, 2);
+		gl_TessLevelOuter[3] = edgeLevel(3, 2);
+		float v = max(edgePixels(vs_world_pos[0].xyz, vs_world_pos[1].xyz),
+		              edgePixels(vs_world_pos[3].xyz, vs_world_pos[2].xyz));
+		float u = max(edgePixels(vs_world_pos[0].xyz, vs_world_pos[3].xyz),
+		              edgePixels(vs_world_pos[1].xyz, vs_world_pos[2].xyz));
+		gl_TessLevelInner[0] = level(v, tess_level_inner);
+		gl_TessLevelInner[1] = level(u, tess_level_inner);
 	}
 }
 )zzz";
 
 const char* ocean_tesseval_shader =
 R"zzz(#version 400 core
-layout(quads) in;
+)zzz" FRAME_UNIFORM_BLOCK R"zzz(layout(quads) in;
 in vec4 tcs_light_direction[];
+uniform bool fft_waves;
+uniform float ocean_patch_size;
+uniform sampler2D ocean_displacement;
+uniform sampler2D ocean_normal;
 out vec4 vs_light_direction;
+out vec4 vs_wave_normal;
 void main()
 {
 	// in triangles, gl_TessCoord is u,v
@@ -229,18 +401,26 @@ void main()
 	vec4 firstLight = mix(tcs_light_direction[0], tcs_light_direction[1], gl_TessCoord.x);
 	vec4 secondLight = mix(tcs_light_direction[3], tcs_light_direction[2], gl_TessCoord.x);
 	vs_light_direction = mix(firstLight, secondLight, gl_TessCoord.y);
+	// The FFT waves are looked up here, the GS sums sinusoids otherwise.
+	vs_wave_normal = vec4(0.0f, 1.0f, 0.0f, 0.0f);
+	if(fft_waves) {
+		vec4 wp = inverse_view * gl_Position;
+		vec2 uv = wp.xz / ocean_patch_size;
+		wp.xyz += textureLod(ocean_displacement, uv, 0.0f).xyz;
+		vs_wave_normal = vec4(textureLod(ocean_normal, uv, 0.0f).xyz, 0.0f);
+		gl_Position = view * wp;
+	}
 }
 )zzz";
 
 const char* ocean_geometry_shader =
 R"zzz(#version 400 core
-layout (triangles) in;
+)zzz" FRAME_UNIFORM_BLOCK OCEAN_WAVE_UNIFORMS R"zzz(layout (triangles) in;
 layout (triangle_strip, max_vertices = 3) out;
-uniform mat4 projection;
-uniform mat4 view;
-uniform float time;
 uniform float tidal_start_time;
+uniform bool fft_waves;
 in vec4 vs_light_direction[];
+in vec4 vs_wave_normal[];
 out vec4 normal;
 flat out vec4 gs_vert_pos[3];
 out vec4 light_direction;
@@ -274,28 +454,32 @@ void main()
 {
 	int n = 0;
 	for (n = 0; n < gl_in.length(); n++) {
-		vec4 wp = inverse(view) * gl_in[n].gl_Position;
-		//sum per wave
-		wp.y += vertexHeight(wp.x, wp.z, vec2(1.0f, 0.0), 0.5f, time, 2.0f, 0.4f);
-		wp.y += vertexHeight(wp.x, wp.z, normalize(vec2(1.0f, 1.0f)), 0.8f, time, 2.0f, 0.5f);
-		float tidalHeight = tidalHeight(wp.x, wp.z, time - tidal_start_time, 1.0f, 30.0f);
+		vec4 wp = inverse_view * gl_in[n].gl_Position;
+		// Slopes of the waves, as (-dh/dx, 1, -dh/dz).
+		vec4 waves = vs_wave_normal[n] / vs_wave_normal[n].y;
+		if(!fft_waves) {
+			//sum per wave, see kWaves in ocean.cc
+			for (int w = 0; w < num_waves; w++) {
+				wp.y += vertexHeight(wp.x, wp.z, wave_direction[w], wave_frequency[w], time, wave_speed[w], wave_amplitude[w]);
+				waves += vertexNormal(wp.x, wp.z, wave_direction[w], wave_frequency[w], time, wave_speed[w], wave_amplitude[w]);
+			}
+		}
+		float tidalHeight = tidalHeight(wp.x, wp.z, time - tidal_start_time, tidal_width, tidal_height);
 		wp.y += tidalHeight;
 		world_position = wp;
 		gs_vert_pos[n] = wp;
 		// normal = normalize(view * vec4(0, 1.0f, 0, 0));
 		normal = normalize(view * 
 			(
-			(tidalNormal(wp.x, wp.z, time - tidal_start_time, 1.0f, 30.0f))
-			+ vertexNormal(wp.x,  wp.z, vec2(1.0f, 0.0), 0.5f, time, 2.0f, 0.4f) 
-			+ vertexNormal(wp.x,  wp.z, normalize(vec2(1.0f, 1.0f)), 0.8f, time, 2.0f, 0.5f)
-			+ vec4(0, 1.0f, 0, 0)
+			(tidalNormal(wp.x, wp.z, time - tidal_start_time, tidal_width, tidal_height))
+			+ waves
 			)
 		);
 		vec3 temp = vec3(0.0f, 0.0f, 0.0f);
 		temp[n] = 1.0f;
 		bary = temp;
 		light_direction = vs_light_direction[n];
-		gl_Position = projection * view * wp;
+		gl_Position = view_projection * wp;
 		EmitVertex();
 	}
 	EndPrimitive();
@@ -306,7 +490,7 @@ void main()
 {
 	int n = 0;
 	for (n = 0; n < gl_in.length(); n++) {
-		vec4 wp = inverse(view) * gl_in[n].gl_Position;
+		vec4 wp = inverse_view * gl_in[n].gl_Position;
 		//sum per wave
 		wp.y += vertexHeight(wp.x, wp.z, vec2(1.0f, 0.0), 0.5f, time, 2.0f, 0.3f);
 		wp.y += vertexHeight(wp.x, wp.z, normalize(vec2(0.9f, 1.0f)), 1.0f, time, 2.0f, 0.4f);
@@ -328,7 +512,7 @@ void main()
 		temp[n] = 1.0f;
 		bary = temp;
 		light_direction = vs_light_direction[n];
-		gl_Position = projection * view * wp;
+		gl_Position = view_projection * wp;
 		EmitVertex();
 	}
 	EndPrimitive();
@@ -336,14 +520,12 @@ void main()
 
 const char* ocean_fragment_shader =
 R"zzz(#version 400 core
-in vec4 normal;
+)zzz" FRAME_UNIFORM_BLOCK SHADOW_MAP_LOOKUP R"zzz(in vec4 normal;
 in vec4 light_direction;
 in vec4 world_position;
 in vec3 bary;
 flat in vec4 gs_vert_pos[3];
 uniform bool wireframe;
-uniform mat4 view;
-uniform vec4 light_position;
 uniform samplerCube skybox;
 uniform bool skybox_mode;
 uniform bool reflective;
@@ -370,7 +552,7 @@ void main()
 		dot_nl = clamp(dot_nl, 0.0, 1.0);
 		vec4 diffuse = clamp(dot_nl * color, 0.0, 1.0);
 		vec4 r = normalize(reflect(-light_direction, normal));
-		vec4 v = normalize(view * (inverse(view)[3] - world_position));
+		vec4 v = normalize(view * (eye_position - world_position));
 
 		vec4 specular = vec4(1.0,1.0,1.0,1.0) * pow(clamp(max(dot(v, r), 0.0f), 0.0f, 1.0f), 24);
 		vec4 ambient = vec4(0, 0, .2, 1.0);
@@ -379,32 +561,19 @@ void main()
 			if(transparent) {
 				vec4 refract = refract(-v, normal, .9f);
 				if(isnan(refract.x)) {
-					temp += .4f * texture(skybox, -(inverse(view) * reflect(v, normal)).xyz);
+					temp += .4f * texture(skybox, -(inverse_view * reflect(v, normal)).xyz);
 				} else {
-					temp += .8f * texture(skybox, (inverse(view) * refract).xyz);
+					temp += .8f * texture(skybox, (inverse_view * refract).xyz);
 				}
 			}
 			if(reflective) {
 				//temp += .4f * texture(skybox, (r).xyz);
-				temp += .4f * texture(skybox, -(inverse(view) * reflect(v, normal)).xyz);
+				temp += .4f * texture(skybox, -(inverse_view * reflect(v, normal)).xyz);
 			}	
 		}
 		temp[3] = 1.0f;
 		vec4 tempColor = clamp(temp, ambient, vec4(1.0,1.0,1.0,1.0));
-		
-		vec4 lightToWorld = normalize(world_position - light_position);
-		float denTop = dot(lightToWorld.xyz, vec3(0, 1.0f, 0));
-		float denSide = dot(lightToWorld.xyz, vec3(1.0f, 0, 0));
-		if(denTop != 0 && denSide != 0) {
-			float tTop = dot(vec3(0, .5f, 0) - light_position.xyz, vec3(0, 1.0f, 0)) / denTop;
-			float tSide = dot(vec3(-.5f, 0, 0) - light_position.xyz, vec3(1.0f, 0, 0)) / denSide;
-			
-			vec4 intersectTop = light_position + tTop * lightToWorld;
-			vec4 intersectSide = light_position + tSide * lightToWorld;
-			if((abs(intersectTop.x) < .5f && abs(intersectTop.z) < .5f) || (abs(intersectSide.y) < .5f && abs(intersectSide.z) < .5f)) {
-				tempColor *= .4f;
-			}
-		}
+		tempColor *= mix(.4f, 1.0f, shadow(world_position));
 		fragment_color = tempColor;
 	}
 }
@@ -413,15 +582,13 @@ void main()
 
 const char* skybox_vertex_shader =
 R"zzz(#version 400 core
-in vec3 vertex_position;
-uniform mat4 view;
-uniform mat4 projection;
+)zzz" FRAME_UNIFORM_BLOCK R"zzz(in vec3 vertex_position;
 out vec4 vs_world_pos;
 void main()
 {
-	vec4 eye_pos = inverse(view)[3];
 	vs_world_pos = vec4(vertex_position, 1.0f);
-	gl_Position = projection * view * vec4(vertex_position + eye_pos.xyz, 1.0f);
+	// z = w puts the sky on the far plane, behind everything else.
+	gl_Position = (view_projection * vec4(vertex_position + eye_position.xyz, 1.0f)).xyww;
 	// gl_Position = projection * view * vertex_position;
 
 }
@@ -433,8 +600,6 @@ const char* skybox_fragment_shader =
 R"zzz(#version 400 core
 in vec4 vs_world_pos;
 flat in vec4 gs_vert_pos[3];
-uniform mat4 view;
-uniform mat4 projection;
 uniform samplerCube skybox;
 out vec4 fragment_color;
 
@@ -456,20 +621,22 @@ CreateFloor(std::vector<glm::vec4>& vertices,
 	indices.push_back(glm::uvec3(0, 3, 2));
 }
 
+// Lays count sponges out on a grid over the floor for stress scenes, of
+// levels 0 to 3 and each turned about y.
 void
-CreateOcean(std::vector<glm::vec4>& vertices,
-        std::vector<glm::uvec4>& indices)
+CreateSpongeField(SpongeField& field, int count)
 {
-	//16 x 16 patches
-	for(int i = 0; i < 16; i++) {
-		for(int k = 0; k < 16; k++) {
-			uint32_t offset = vertices.size();
-			vertices.push_back(glm::vec4(-20.0f + 2.5f * i, -2.0f, -20.0f + 2.5f * k, 1.0f));
-			vertices.push_back(glm::vec4(-20.0f + 2.5f * (i + 1), -2.0f, -20.0f + 2.5f * k, 1.0f));
-			vertices.push_back(glm::vec4(-20.0f + 2.5f * i, -2.0f, -20.0f + 2.5f * (k + 1), 1.0f));
-			vertices.push_back(glm::vec4(-20.0f + 2.5f * (i + 1), -2.0f, -20.0f + 2.5f * (k + 1), 1.0f));
-			indices.push_back(glm::uvec4(offset, offset + 2, offset + 3, offset + 1));
-		}
+	int side = std::ceil(std::sqrt(float(count)));
+	float spacing = 18.0f / side;
+	float scale = std::min(1.0f, 0.7f * spacing);
+	for (int i = 0; i < count; ++i) {
+		int x = i % side, z = i / side;
+		glm::vec3 position((x + 0.5f) * spacing - 9.0f, -3.0f + 0.5f * scale,
+		                   (z + 0.5f) * spacing - 9.0f);
+		glm::mat4 transform = glm::translate(glm::mat4(1.0f), position);
+		transform = glm::rotate(transform, 2.4f * i, glm::vec3(0.0f, 1.0f, 0.0f));
+		transform = glm::scale(transform, glm::vec3(scale));
+		field.add(transform, (x + z) % 4);
 	}
 }
 
@@ -483,6 +650,54 @@ CreateTriangle(std::vector<glm::vec4>& vertices,
 	indices.push_back(glm::uvec3(0, 1, 2));
 }
 
+// Copies the sponge back out of its GL buffers, for when no CPU copy is
+// kept. The element buffer is bound to a copy target, so no VAO changes.
+void
+ReadBackGeometry(std::vector<glm::vec4>& vertices,
+        std::vector<glm::uvec3>& faces, size_t index_count)
+{
+	GLint64 size = 0;
+	void* data = nullptr;
+	CHECK_GL_ERROR(glBindBuffer(GL_COPY_READ_BUFFER, g_buffer_objects[kGeometryVao][kVertexBuffer]));
+	CHECK_GL_ERROR(glGetBufferParameteri64v(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size));
+	vertices.resize(size / sizeof(glm::vec4));
+	if (size > 0) {
+		CHECK_GL_ERROR(data = glMapBufferRange(GL_COPY_READ_BUFFER, 0, size, GL_MAP_READ_BIT));
+		memcpy(vertices.data(), data, vertices.size() * sizeof(glm::vec4));
+		CHECK_GL_ERROR(glUnmapBuffer(GL_COPY_READ_BUFFER));
+	}
+
+	faces.resize(index_count / 3);
+	size = faces.size() * sizeof(glm::uvec3);
+	CHECK_GL_ERROR(glBindBuffer(GL_COPY_READ_BUFFER, g_buffer_objects[kGeometryVao][kIndexBuffer]));
+	if (size > 0) {
+		CHECK_GL_ERROR(data = glMapBufferRange(GL_COPY_READ_BUFFER, 0, size, GL_MAP_READ_BIT));
+		memcpy(faces.data(), data, size);
+		CHECK_GL_ERROR(glUnmapBuffer(GL_COPY_READ_BUFFER));
+	}
+}
+
+// Bytes held for each sponge buffer in system memory and by GL, as CSV.
+void
+ReportMemory(std::ostream& out, const std::vector<glm::vec4>& vertices,
+        const std::vector<glm::vec4>& normals,
+        const std::vector<glm::uvec3>& faces)
+{
+	const char* names[kNumVbos] = { "vertex", "normal", "index" };
+	size_t cpu[kNumVbos] = {
+		vertices.capacity() * sizeof(glm::vec4),
+		normals.capacity() * sizeof(glm::vec4),
+		faces.capacity() * sizeof(glm::uvec3)
+	};
+	out << "buffer,cpu_bytes,gpu_bytes\n";
+	for (int i = 0; i < kNumVbos; ++i) {
+		GLint64 gpu = 0;
+		CHECK_GL_ERROR(glBindBuffer(GL_COPY_READ_BUFFER, g_buffer_objects[kGeometryVao][i]));
+		CHECK_GL_ERROR(glGetBufferParameteri64v(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &gpu));
+		out << names[i] << "," << cpu[i] << "," << gpu << "\n";
+	}
+}
+
 
 // float*
 // create_skybox()
@@ -493,23 +708,6 @@ CreateTriangle(std::vector<glm::vec4>& vertices,
 // }
 
 
-// FIXME: Save geometry to OBJ file
-void
-SaveObj(const std::string& file,
-        const std::vector<glm::vec4>& vertices,
-        const std::vector<glm::uvec3>& indices)
-{
-	std::ofstream f;
-	f.open(file);
-	for (auto &v : vertices) {
-    	f << "v " << v.x << " " << v.y << " " << v.z << std::endl;
-	}
-	for (auto &i : indices) {
-    	f << "f " << (i.x + 1) << " " << (i.y + 1) << " " << (i.z + 1) << std::endl;
-	}
-	f.close();
-}
-
 void
 ErrorCallback(int error, const char* description)
 {
@@ -520,6 +718,7 @@ ErrorCallback(int error, const char* description)
 std::shared_ptr<Menger> g_menger;
 Camera g_camera;
 bool save_obj = false;
+bool report_memory = false;
 bool wireframe = true;
 bool toggleFaces = true;
 float tess_level_inner = 3.0f;
@@ -531,6 +730,11 @@ bool skybox_mode = true;
 bool reflective = true;
 bool transparent = true;
 
+bool recording = false;
+bool gpu_timing = false;
+// Set when something outside Camera and Menger needs a new frame.
+bool g_redraw = true;
+
 void
 KeyCallback(GLFWwindow* window,
             int key,
@@ -541,17 +745,25 @@ KeyCallback(GLFWwindow* window,
 	// Note:
 	// This is only a list of functions to implement.
 	// you may want to re-organize this piece of code.
+	// Almost every key changes a toggle, so any key earns a new frame.
+	g_redraw = true;
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, GL_TRUE);
 	else if (key == GLFW_KEY_S && mods == GLFW_MOD_CONTROL && action == GLFW_RELEASE) {
 		// FIXME: save geometry to OBJ
 		save_obj = true;
+	} else if (key == GLFW_KEY_M && action == GLFW_RELEASE) {
+		report_memory = true;
 	} else if (key == GLFW_KEY_Z && action == GLFW_RELEASE) {
 		skybox_mode = !skybox_mode;
 	} else if (key == GLFW_KEY_X && action == GLFW_RELEASE) {
 		transparent = !transparent;
 	} else if (key == GLFW_KEY_V && action == GLFW_RELEASE) {
 		reflective = !reflective;
+	} else if (key == GLFW_KEY_R && action == GLFW_RELEASE) {
+		recording = !recording;
+	} else if (key == GLFW_KEY_P && action == GLFW_RELEASE) {
+		gpu_timing = !gpu_timing;
 	} else if (key == GLFW_KEY_T && mods == GLFW_MOD_CONTROL && action == GLFW_RELEASE) {
 		save_time = true;
 	} else if (key == GLFW_KEY_W && action != GLFW_RELEASE) {
@@ -645,6 +857,19 @@ MousePosCallback(GLFWwindow* window, double mouse_x, double mouse_y)
 	g_camera.last_x = mouse_x;
 }
 
+// The window was uncovered or resized and lost its contents.
+void
+RefreshCallback(GLFWwindow* window)
+{
+	g_redraw = true;
+}
+
+void
+FramebufferSizeCallback(GLFWwindow* window, int width, int height)
+{
+	g_redraw = true;
+}
+
 void
 MouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
 {
@@ -652,59 +877,238 @@ MouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
 	g_current_button = button;
 }
 
+ReplayState
+SaveReplayState(float tidal_start_time)
+{
+	ReplayState state;
+	state.nesting_level = g_menger->get_nesting_level();
+	state.ocean_mode = ocean_mode;
+	state.wireframe = wireframe;
+	state.faces = toggleFaces;
+	state.skybox = skybox_mode;
+	state.reflective = reflective;
+	state.transparent = transparent;
+	state.tess_level_inner = tess_level_inner;
+	state.tess_level_outer = tess_level_outer;
+	state.tidal_start_time = tidal_start_time;
+	return state;
+}
+
+void
+LoadReplayState(const ReplayState& state)
+{
+	// Setting the level regenerates the sponge, even to the same value.
+	if (state.nesting_level != g_menger->get_nesting_level())
+		g_menger->set_nesting_level(state.nesting_level);
+	ocean_mode = state.ocean_mode;
+	wireframe = state.wireframe;
+	toggleFaces = state.faces;
+	skybox_mode = state.skybox;
+	reflective = state.reflective;
+	transparent = state.transparent;
+	tess_level_inner = state.tess_level_inner;
+	tess_level_outer = state.tess_level_outer;
+}
+
+// Uploads the wave table of ocean.h, shared with the CPU evaluator.
+void
+SetOceanUniforms(GLuint program)
+{
+	glm::vec2 direction[kNumWaves];
+	float frequency[kNumWaves], speed[kNumWaves], amplitude[kNumWaves];
+	for (int i = 0; i < kNumWaves; ++i) {
+		direction[i] = kWaves[i].direction;
+		frequency[i] = kWaves[i].frequency;
+		speed[i] = kWaves[i].speed;
+		amplitude[i] = kWaves[i].amplitude;
+	}
+	CHECK_GL_ERROR(glUseProgram(program));
+	CHECK_GL_ERROR(glUniform2fv(glGetUniformLocation(program, "wave_direction"),
+				kNumWaves, &direction[0][0]));
+	CHECK_GL_ERROR(glUniform1fv(glGetUniformLocation(program, "wave_frequency"),
+				kNumWaves, frequency));
+	CHECK_GL_ERROR(glUniform1fv(glGetUniformLocation(program, "wave_speed"),
+				kNumWaves, speed));
+	CHECK_GL_ERROR(glUniform1fv(glGetUniformLocation(program, "wave_amplitude"),
+				kNumWaves, amplitude));
+	CHECK_GL_ERROR(glUniform1f(glGetUniformLocation(program, "tidal_width"),
+				kTidalWidth));
+	CHECK_GL_ERROR(glUniform1f(glGetUniformLocation(program, "tidal_height"),
+				kTidalHeight));
+}
+
 int main(int argc, char* argv[])
 {
 	int i = 0;
 	bool has_cubemap = false;
 	std::string cubemape_folder;
-
-	while ((i = getopt(argc, argv, "c:")) != EOF) {
+	int cubemap_max_size = 0;
+	std::string capture_prefix = "frame_";
+	int capture_quality = 90;
+	std::string shader_cache_dir = "shader_cache";
+	bool debug_output = false;
+	bool debug_synchronous = false;
+	bool debug_abort = false;
+	bool sponge_geometry_shader = false;
+	bool fft_waves = false;
+	bool gpu_generation = false;
+	int field_size = 0;
+	std::string trace_image;
+	int trace_width = window_width, trace_height = window_height;
+	int trace_samples = 16;
+	bool lean_memory = false;
+	bool optimize_mesh = false;
+	bool compress_cubemap = true;
+	int bench_frames = 0;
+	int nesting_level = 1;
+	std::string bench_image;
+	std::string replay_file;
+	bool replay_playback = false;
+
+	while ((i = getopt(argc, argv, "c:r:o:q:s:dDAgGfpb:l:wi:e:E:n:t:W:H:S:mOu")) != EOF) {
 		if(i == 'c') {
 			has_cubemap = true;
 			cubemape_folder = optarg;
+		} else if(i == 'r') {
+			cubemap_max_size = atoi(optarg);
+		} else if(i == 'o') {
+			capture_prefix = optarg;
+			recording = true;
+		} else if(i == 'q') {
+			capture_quality = atoi(optarg);
+		} else if(i == 's') {
+			shader_cache_dir = optarg;
+		} else if(i == 'd') {
+			debug_output = true;
+		} else if(i == 'D') {
+			debug_output = true;
+			debug_synchronous = true;
+		} else if(i == 'A') {
+			debug_output = true;
+			debug_abort = true;
+		} else if(i == 'g') {
+			sponge_geometry_shader = true;
+		} else if(i == 'G') {
+			gpu_generation = true;
+		} else if(i == 'f') {
+			fft_waves = true;
+		} else if(i == 'p') {
+			gpu_timing = true;
+		} else if(i == 'b') {
+			bench_frames = atoi(optarg);
+		} else if(i == 'l') {
+			nesting_level = atoi(optarg);
+		} else if(i == 'w') {
+			ocean_mode = true;
+		} else if(i == 'i') {
+			bench_image = optarg;
+		} else if(i == 'e') {
+			replay_file = optarg;
+		} else if(i == 'E') {
+			replay_file = optarg;
+			replay_playback = true;
+		} else if(i == 'n') {
+			field_size = atoi(optarg);
+		} else if(i == 't') {
+			trace_image = optarg;
+		} else if(i == 'W') {
+			trace_width = atoi(optarg);
+		} else if(i == 'H') {
+			trace_height = atoi(optarg);
+		} else if(i == 'S') {
+			trace_samples = atoi(optarg);
+		} else if(i == 'm') {
+			lean_memory = true;
+		} else if(i == 'O') {
+			optimize_mesh = true;
+		} else if(i == 'u') {
+			compress_cubemap = false;
 		}
 	}
+	// Benchmarks render offscreen, with no window, input or vsync.
+	bool headless = bench_frames > 0;
+	if (headless)
+		gpu_timing = true;
+
+	// Offline renders need neither a window nor a GPU.
+	if (!trace_image.empty()) {
+		if (trace_width <= 0 || trace_height <= 0 || trace_samples <= 0) {
+			std::cerr << "-W, -H and -S must be positive\n";
+			exit(EXIT_FAILURE);
+		}
+		trace_samples = RayTracer::rounded_samples(trace_samples);
+		RayTracer tracer(nesting_level, kLightPosition);
+		std::vector<unsigned char> pixels;
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		tracer.render(g_camera.get_view_matrix(), glm::radians(kFieldOfView),
+				trace_width, trace_height, trace_samples, &pixels);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		double seconds = (end.tv_sec - start.tv_sec) +
+			double(end.tv_nsec - start.tv_nsec) / BILLION;
+		std::cout << "Ray traced " << trace_width << "x" << trace_height
+		          << " at " << trace_samples << " samples in " << seconds
+		          << " s\n";
+		CHECK_SUCCESS(SaveJPEG(trace_image, trace_width, trace_height,
+					pixels.data(), capture_quality));
+		exit(EXIT_SUCCESS);
+	}
 
 	std::string window_title = "Menger";
-	if (!glfwInit()) exit(EXIT_FAILURE);
 	g_menger = std::make_shared<Menger>();
-	glfwSetErrorCallback(ErrorCallback);
-
-	// Ask an OpenGL 4.1 core profile context
-	// It is required on OSX and non-NVIDIA Linux
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	GLFWwindow* window = glfwCreateWindow(window_width, window_height,
-			&window_title[0], nullptr, nullptr);
-	CHECK_SUCCESS(window != nullptr);
-	glfwMakeContextCurrent(window);
-	glewExperimental = GL_TRUE;
-
-	CHECK_SUCCESS(glewInit() == GLEW_OK);
-	glGetError();  // clear GLEW's error for it
-	glfwSetKeyCallback(window, KeyCallback);
-	glfwSetCursorPosCallback(window, MousePosCallback);
-	glfwSetMouseButtonCallback(window, MouseButtonCallback);
-	glfwSwapInterval(1);
+	g_camera.set_collider(g_menger.get(), kCameraRadius);
+	GLFWwindow* window = nullptr;
+	std::unique_ptr<HeadlessContext> headless_context;
+	if (headless) {
+		headless_context.reset(new HeadlessContext(window_width, window_height,
+					debug_output));
+		CHECK_SUCCESS(headless_context->is_valid());
+	} else {
+		if (!glfwInit()) exit(EXIT_FAILURE);
+		glfwSetErrorCallback(ErrorCallback);
+
+		// Ask an OpenGL 4.1 core profile context
+		// It is required on OSX and non-NVIDIA Linux
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		if (debug_output)
+			glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+		window = glfwCreateWindow(window_width, window_height,
+				&window_title[0], nullptr, nullptr);
+		CHECK_SUCCESS(window != nullptr);
+		glfwMakeContextCurrent(window);
+		glewExperimental = GL_TRUE;
+
+		CHECK_SUCCESS(glewInit() == GLEW_OK);
+		glGetError();  // clear GLEW's error for it
+		glfwSetKeyCallback(window, KeyCallback);
+		glfwSetCursorPosCallback(window, MousePosCallback);
+		glfwSetMouseButtonCallback(window, MouseButtonCallback);
+		glfwSetWindowRefreshCallback(window, RefreshCallback);
+		glfwSetFramebufferSizeCallback(window, FramebufferSizeCallback);
+		glfwSwapInterval(1);
+	}
+	if (debug_output && !DebugGLEnableOutput(debug_synchronous, debug_abort))
+		std::cerr << "KHR_debug is not supported, -d/-D/-A ignored\n";
 	const GLubyte* renderer = glGetString(GL_RENDERER);  // get renderer string
 	const GLubyte* version = glGetString(GL_VERSION);    // version as a string
 	std::cout << "Renderer: " << renderer << "\n";
 	std::cout << "OpenGL version supported:" << version << "\n";
 
 	std::vector<glm::vec4> obj_vertices;
+	std::vector<glm::vec4> obj_normals;
 	std::vector<glm::uvec3> obj_faces;
 
 	std::vector<glm::vec4> floor_vertices;
 	std::vector<glm::uvec3> floor_faces;
 	CreateFloor(floor_vertices, floor_faces);
 
-	std::vector<glm::vec4> ocean_vertices;
-	std::vector<glm::uvec4> ocean_faces;
-	CreateOcean(ocean_vertices, ocean_faces);
+	OceanClipmap ocean_clipmap;
+	std::vector<OceanClipmap::Ring> ocean_rings;
 
-	g_menger->set_nesting_level(1);
+	g_menger->set_nesting_level(nesting_level);
 
 	glm::vec4 min_bounds = glm::vec4(std::numeric_limits<float>::max());
 	glm::vec4 max_bounds = glm::vec4(-std::numeric_limits<float>::max());
@@ -733,6 +1137,15 @@ int main(int argc, char* argv[])
 	CHECK_GL_ERROR(glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0));
 	CHECK_GL_ERROR(glEnableVertexAttribArray(0));
 
+	// Face normals, ignored by the geometry shader path.
+	CHECK_GL_ERROR(glBindBuffer(GL_ARRAY_BUFFER, g_buffer_objects[kGeometryVao][kNormalBuffer]));
+	CHECK_GL_ERROR(glBufferData(GL_ARRAY_BUFFER,
+				sizeof(float) * obj_normals.size() * 4, obj_normals.data(),
+				GL_STATIC_DRAW));
+	CHECK_GL_ERROR(glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 0, 0));
+	CHECK_GL_ERROR(glEnableVertexAttribArray(1));
+	CHECK_GL_ERROR(glProvokingVertex(GL_LAST_VERTEX_CONVENTION));
+
 	// Setup element array buffer.
 	CHECK_GL_ERROR(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_buffer_objects[kGeometryVao][kIndexBuffer]));
 	CHECK_GL_ERROR(glBufferData(GL_ELEMENT_ARRAY_BUFFER,
@@ -760,14 +1173,15 @@ int main(int argc, char* argv[])
 	CHECK_GL_ERROR(glGenBuffers(kNumVbos, &g_buffer_objects[kOceanVao][0]));
 	CHECK_GL_ERROR(glBindBuffer(GL_ARRAY_BUFFER, g_buffer_objects[kOceanVao][kVertexBuffer]));
 	CHECK_GL_ERROR(glBufferData(GL_ARRAY_BUFFER,
-				sizeof(float) * ocean_vertices.size() * 4, ocean_vertices.data(),
+				sizeof(float) * ocean_clipmap.vertices().size() * 4,
+				ocean_clipmap.vertices().data(),
 				GL_STATIC_DRAW));
 	CHECK_GL_ERROR(glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0));
 	CHECK_GL_ERROR(glEnableVertexAttribArray(0));
 	CHECK_GL_ERROR(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_buffer_objects[kOceanVao][kIndexBuffer]));
 	CHECK_GL_ERROR(glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-				sizeof(uint32_t) * ocean_faces.size() * 4,
-				ocean_faces.data(), GL_STATIC_DRAW));
+				sizeof(uint32_t) * ocean_clipmap.patches().size() * 4,
+				ocean_clipmap.patches().data(), GL_STATIC_DRAW));
 
 // Switch to the Skybox VAO
 
@@ -843,269 +1257,125 @@ float sky_pts[] = {
 
 
 	if(has_cubemap){
-
-	
-		Image px;
-		if(LoadJPEG(cubemape_folder + "posx.jpg", &px)){
-			CHECK_GL_ERROR(glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap_texture));
-			CHECK_GL_ERROR(glTexImage2D(
-				GL_TEXTURE_CUBE_MAP_POSITIVE_X,
-				0,
-				GL_RGBA,
-				px.width,
-				px.height,
-				0,
-				GL_RGB,
-				GL_UNSIGNED_BYTE,
-				px.bytes.data()
-				));
-		}else{
-			std::cout << "LOADING POSX SKYBOX FAILED" << std::endl;
-		}
-		Image nx;
-		if(LoadJPEG(cubemape_folder + "negx.jpg", &nx)){
-			CHECK_GL_ERROR(glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap_texture));
-			CHECK_GL_ERROR(glTexImage2D(
-				GL_TEXTURE_CUBE_MAP_NEGATIVE_X,
-				0,
-				GL_RGBA,
-				px.width,
-				px.height,
-				0,
-				GL_RGB,
-				GL_UNSIGNED_BYTE,
-				nx.bytes.data()
-				));
-		}else{
-			std::cout << "LOADING NEGX SKYBOX FAILED" << std::endl;
-		}
-		Image py;
-		if(LoadJPEG(cubemape_folder + "posy.jpg", &py)){
-			CHECK_GL_ERROR(glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap_texture));
-			CHECK_GL_ERROR(glTexImage2D(
-				GL_TEXTURE_CUBE_MAP_POSITIVE_Y,
-				0,
-				GL_RGBA,
-				px.width,
-				px.height,
-				0,
-				GL_RGB,
-				GL_UNSIGNED_BYTE,
-				py.bytes.data()
-				));
-		}else{
-			std::cout << "LOADING POSY SKYBOX FAILED" << std::endl;
-		}
-		Image ny;
-		if(LoadJPEG(cubemape_folder + "negy.jpg", &ny)){
-			CHECK_GL_ERROR(glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap_texture));
-			CHECK_GL_ERROR(glTexImage2D(
-				GL_TEXTURE_CUBE_MAP_NEGATIVE_Y,
-				0,
-				GL_RGBA,
-				px.width,
-				px.height,
-				0,
-				GL_RGB,
-				GL_UNSIGNED_BYTE,
-				ny.bytes.data()
-				));
-		}else{
-			std::cout << "LOADING NEGZ SKYBOX FAILED" << std::endl;
+		const char* face_files[6] = {
+			"posx.jpg", "negx.jpg", "posy.jpg", "negy.jpg", "posz.jpg", "negz.jpg"
+		};
+		const GLenum face_targets[6] = {
+			GL_TEXTURE_CUBE_MAP_POSITIVE_X, GL_TEXTURE_CUBE_MAP_NEGATIVE_X,
+			GL_TEXTURE_CUBE_MAP_POSITIVE_Y, GL_TEXTURE_CUBE_MAP_NEGATIVE_Y,
+			GL_TEXTURE_CUBE_MAP_POSITIVE_Z, GL_TEXTURE_CUBE_MAP_NEGATIVE_Z
+		};
+		Image faces[6] = {};
+		for (int f = 0; f < 6; ++f) {
+			if (!LoadJPEG(cubemape_folder + face_files[f], &faces[f], cubemap_max_size)) {
+				std::cout << "LOADING " << face_files[f] << " SKYBOX FAILED" << std::endl;
+			}
 		}
-		Image pz;
-		if(LoadJPEG(cubemape_folder + "posz.jpg", &pz)){
-			CHECK_GL_ERROR(glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap_texture));
-			CHECK_GL_ERROR(glTexImage2D(
-				GL_TEXTURE_CUBE_MAP_POSITIVE_Z,
-				0,
-				GL_RGBA,
-				px.width,
-				px.height,
-				0,
-				GL_RGB,
-				GL_UNSIGNED_BYTE,
-				pz.bytes.data()
-				));
-		}else{
-			std::cout << "LOADING POSZ SKYBOX FAILED" << std::endl;
+
+		// Build the mip chains ourselves instead of relying on
+		// glGenerateMipmap, one face per thread.
+		std::vector<Image> face_mips[6];
+		GenerateCubemapMipChains(faces, face_mips, kMipFilterKaiser);
+
+		// BC1 takes an eighth of the memory and bandwidth of RGBA8. It is
+		// encoded on every load rather than cached on disk, as it costs
+		// about as much as decoding the JPEGs.
+		if (compress_cubemap && !HasGLExtension("GL_EXT_texture_compression_s3tc")) {
+			std::cerr << "S3TC is not supported, the cube map is not compressed\n";
+			compress_cubemap = false;
 		}
-		Image nz;
-		if(LoadJPEG(cubemape_folder + "negz.jpg", &nz)){
-			CHECK_GL_ERROR(glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap_texture));
-			CHECK_GL_ERROR(glTexImage2D(
-				GL_TEXTURE_CUBE_MAP_NEGATIVE_Z,
-				0,
-				GL_RGBA,
-				px.width,
-				px.height,
-				0,
-				GL_RGB,
-				GL_UNSIGNED_BYTE,
-				nz.bytes.data()
-				));
-		}else{
-			std::cout << "LOADING NEGZ SKYBOX FAILED" << std::endl;
+		std::vector<CompressedImage> compressed[6];
+		if (compress_cubemap)
+			CompressCubemapBC1(faces, face_mips, compressed);
+
+		CHECK_GL_ERROR(glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap_texture));
+		// Mip rows are tightly packed RGB.
+		CHECK_GL_ERROR(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+		int max_level = 0;
+		size_t texels = 0, compressed_bytes = 0;
+		for (int f = 0; f < 6; ++f) {
+			if (faces[f].bytes.empty())
+				continue;
+			for (int level = 0; level <= int(face_mips[f].size()); ++level) {
+				const Image& image = (level == 0) ? faces[f] : face_mips[f][level - 1];
+				texels += size_t(image.width) * image.height;
+				if (compress_cubemap) {
+					const CompressedImage& blocks = compressed[f][level];
+					compressed_bytes += blocks.bytes.size();
+					CHECK_GL_ERROR(glCompressedTexImage2D(
+						face_targets[f],
+						level,
+						kBC1Format,
+						blocks.width,
+						blocks.height,
+						0,
+						blocks.bytes.size(),
+						blocks.bytes.data()
+						));
+					continue;
+				}
+				CHECK_GL_ERROR(glTexImage2D(
+					face_targets[f],
+					level,
+					GL_RGBA,
+					image.width,
+					image.height,
+					0,
+					GL_RGB,
+					GL_UNSIGNED_BYTE,
+					image.bytes.data()
+					));
+			}
+			max_level = std::max(max_level, int(face_mips[f].size()));
 		}
+		if (compress_cubemap)
+			std::cout << "Cube map compressed to BC1: " << compressed_bytes
+			          << " bytes instead of " << texels * 4 << "\n";
+		CHECK_GL_ERROR(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+		CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0));
+		CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, max_level));
 		CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
-	  	CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
-	  	CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE));
-	  	CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
-	  	CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
-  }
-
-
-
-	// Setup vertex shader.
-	GLuint vertex_shader_id = 0;
-	const char* vertex_source_pointer = vertex_shader;
-	CHECK_GL_ERROR(vertex_shader_id = glCreateShader(GL_VERTEX_SHADER));
-	CHECK_GL_ERROR(glShaderSource(vertex_shader_id, 1, &vertex_source_pointer, nullptr));
-	glCompileShader(vertex_shader_id);
-	CHECK_GL_SHADER_ERROR(vertex_shader_id);
-
-	// Setup geometry shader.
-	GLuint geometry_shader_id = 0;
-	const char* geometry_source_pointer = geometry_shader;
-	CHECK_GL_ERROR(geometry_shader_id = glCreateShader(GL_GEOMETRY_SHADER));
-	CHECK_GL_ERROR(glShaderSource(geometry_shader_id, 1, &geometry_source_pointer, nullptr));
-	glCompileShader(geometry_shader_id);
-	CHECK_GL_SHADER_ERROR(geometry_shader_id);
-
-	// Setup fragment shader.
-	GLuint fragment_shader_id = 0;
-	const char* fragment_source_pointer = fragment_shader;
-	CHECK_GL_ERROR(fragment_shader_id = glCreateShader(GL_FRAGMENT_SHADER));
-	CHECK_GL_ERROR(glShaderSource(fragment_shader_id, 1, &fragment_source_pointer, nullptr));
-	glCompileShader(fragment_shader_id);
-	CHECK_GL_SHADER_ERROR(fragment_shader_id);
-
-	// Setup fragment shader for the floor
-	GLuint floor_fragment_shader_id = 0;
-	const char* floor_fragment_source_pointer = floor_fragment_shader;
-	CHECK_GL_ERROR(floor_fragment_shader_id = glCreateShader(GL_FRAGMENT_SHADER));
-	CHECK_GL_ERROR(glShaderSource(floor_fragment_shader_id, 1,
-				&floor_fragment_source_pointer, nullptr));
-	glCompileShader(floor_fragment_shader_id);
-	CHECK_GL_SHADER_ERROR(floor_fragment_shader_id);
-
-	GLuint floor_tesscontrol_shader_id = 0;
-	const char* floor_tesscontrol_source_pointer = floor_tesscontrol_shader;
-	CHECK_GL_ERROR(floor_tesscontrol_shader_id = glCreateShader(GL_TESS_CONTROL_SHADER));
-	CHECK_GL_ERROR(glShaderSource(floor_tesscontrol_shader_id, 1,
-				&floor_tesscontrol_source_pointer, nullptr));
-	glCompileShader(floor_tesscontrol_shader_id);
-	CHECK_GL_SHADER_ERROR(floor_tesscontrol_shader_id);
-
-	GLuint floor_tesseval_shader_id = 0;
-	const char* floor_tesseval_source_pointer = floor_tesseval_shader;
-	CHECK_GL_ERROR(floor_tesseval_shader_id = glCreateShader(GL_TESS_EVALUATION_SHADER));
-	CHECK_GL_ERROR(glShaderSource(floor_tesseval_shader_id, 1,
-				&floor_tesseval_source_pointer, nullptr));
-	glCompileShader(floor_tesseval_shader_id);
-	CHECK_GL_SHADER_ERROR(floor_tesseval_shader_id);
-
-	// ocean
-
-	GLuint ocean_tesscontrol_shader_id = 0;
-	const char* ocean_tesscontrol_source_pointer = ocean_tesscontrol_shader;
-	CHECK_GL_ERROR(ocean_tesscontrol_shader_id = glCreateShader(GL_TESS_CONTROL_SHADER));
-	CHECK_GL_ERROR(glShaderSource(ocean_tesscontrol_shader_id, 1,
-				&ocean_tesscontrol_source_pointer, nullptr));
-	glCompileShader(ocean_tesscontrol_shader_id);
-	CHECK_GL_SHADER_ERROR(ocean_tesscontrol_shader_id);
-
-	GLuint ocean_tesseval_shader_id = 0;
-	const char* ocean_tesseval_source_pointer = ocean_tesseval_shader;
-	CHECK_GL_ERROR(ocean_tesseval_shader_id = glCreateShader(GL_TESS_EVALUATION_SHADER));
-	CHECK_GL_ERROR(glShaderSource(ocean_tesseval_shader_id, 1,
-				&ocean_tesseval_source_pointer, nullptr));
-	glCompileShader(ocean_tesseval_shader_id);
-	CHECK_GL_SHADER_ERROR(ocean_tesseval_shader_id);
-
-	GLuint ocean_geometry_shader_id = 0;
-	const char* ocean_geometry_source_pointer = ocean_geometry_shader;
-	CHECK_GL_ERROR(ocean_geometry_shader_id = glCreateShader(GL_GEOMETRY_SHADER));
-	CHECK_GL_ERROR(glShaderSource(ocean_geometry_shader_id, 1,
-				&ocean_geometry_source_pointer, nullptr));
-	glCompileShader(ocean_geometry_shader_id);
-	CHECK_GL_SHADER_ERROR(ocean_geometry_shader_id);
-
-	GLuint ocean_fragment_shader_id = 0;
-	const char* ocean_fragment_source_pointer = ocean_fragment_shader;
-	CHECK_GL_ERROR(ocean_fragment_shader_id = glCreateShader(GL_FRAGMENT_SHADER));
-	CHECK_GL_ERROR(glShaderSource(ocean_fragment_shader_id, 1,
-				&ocean_fragment_source_pointer, nullptr));
-	glCompileShader(ocean_fragment_shader_id);
-	CHECK_GL_SHADER_ERROR(ocean_fragment_shader_id);
-
-	// skybox
-
-	GLuint skybox_vertex_shader_id = 0;
-	const char* skybox_vertex_source_pointer = skybox_vertex_shader;
-	CHECK_GL_ERROR(skybox_vertex_shader_id = glCreateShader(GL_VERTEX_SHADER));
-	CHECK_GL_ERROR(glShaderSource(skybox_vertex_shader_id, 1, &skybox_vertex_source_pointer, nullptr));
-	glCompileShader(skybox_vertex_shader_id);
-	CHECK_GL_SHADER_ERROR(skybox_vertex_shader_id);
-
-	GLuint skybox_fragment_shader_id = 0;
-	const char* skybox_fragment_source_pointer = skybox_fragment_shader;
-	CHECK_GL_ERROR(skybox_fragment_shader_id = glCreateShader(GL_FRAGMENT_SHADER));
-	CHECK_GL_ERROR(glShaderSource(skybox_fragment_shader_id, 1,
-				&skybox_fragment_source_pointer, nullptr));
-	glCompileShader(skybox_fragment_shader_id);
-	CHECK_GL_SHADER_ERROR(skybox_fragment_shader_id);
-
-	// Let's create our program.
-	GLuint program_id = 0;
-	CHECK_GL_ERROR(program_id = glCreateProgram());
-	CHECK_GL_ERROR(glAttachShader(program_id, vertex_shader_id));
-	CHECK_GL_ERROR(glAttachShader(program_id, fragment_shader_id));
-	CHECK_GL_ERROR(glAttachShader(program_id, geometry_shader_id));
+		CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR));
+		CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE));
+		CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+		CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+	}
+	// Unit 0 keeps the cube map for the skybox and the ocean reflections.
+	CHECK_GL_ERROR(glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap_texture));
+	CHECK_GL_ERROR(glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS));
 
-	// Bind attributes.
-	CHECK_GL_ERROR(glBindAttribLocation(program_id, 0, "vertex_position"));
-	CHECK_GL_ERROR(glBindFragDataLocation(program_id, 0, "fragment_color"));
-	glLinkProgram(program_id);
-	CHECK_GL_PROGRAM_ERROR(program_id);
 
-	// Get the uniform locations.
-	GLint projection_matrix_location = 0;
-	CHECK_GL_ERROR(projection_matrix_location =
-			glGetUniformLocation(program_id, "projection"));
-	GLint view_matrix_location = 0;
-	CHECK_GL_ERROR(view_matrix_location =
-			glGetUniformLocation(program_id, "view"));
-	GLint light_position_location = 0;
-	CHECK_GL_ERROR(light_position_location =
-			glGetUniformLocation(program_id, "light_position"));
+
+	// Compile and link our programs, or load them from the cache.
+	ProgramCache program_cache(shader_cache_dir);
+	GLuint program_id = 0;
+	if (sponge_geometry_shader) {
+		program_id = program_cache.build("sponge_gs", {
+				{ GL_VERTEX_SHADER, vertex_shader },
+				{ GL_GEOMETRY_SHADER, geometry_shader },
+				{ GL_FRAGMENT_SHADER, fragment_shader } });
+	} else {
+		program_id = program_cache.build("sponge", {
+				{ GL_VERTEX_SHADER, flat_vertex_shader },
+				{ GL_FRAGMENT_SHADER, fragment_shader } },
+				{ "vertex_position", "vertex_normal" });
+	}
+
+	GLuint field_program_id = program_cache.build("sponge_field", {
+			{ GL_VERTEX_SHADER, instanced_vertex_shader },
+			{ GL_FRAGMENT_SHADER, fragment_shader } },
+			{ "vertex_position", "vertex_normal", "instance_transform" });
 
 	// FIXME: Setup another program for the floor, and get its locations.
 	// Note: you can reuse the vertex and geometry shader objects
-	GLuint floor_program_id = 0;
-	CHECK_GL_ERROR(floor_program_id = glCreateProgram());
-	CHECK_GL_ERROR(glAttachShader(floor_program_id, vertex_shader_id));
-	CHECK_GL_ERROR(glAttachShader(floor_program_id, floor_fragment_shader_id));
-	CHECK_GL_ERROR(glAttachShader(floor_program_id, floor_tesscontrol_shader_id));
-	CHECK_GL_ERROR(glAttachShader(floor_program_id, floor_tesseval_shader_id));
-	CHECK_GL_ERROR(glAttachShader(floor_program_id, geometry_shader_id));
-
-	// Bind attributes.
-	CHECK_GL_ERROR(glBindAttribLocation(floor_program_id, 0, "vertex_position"));
-	CHECK_GL_ERROR(glBindFragDataLocation(floor_program_id, 0, "fragment_color"));
-	glLinkProgram(floor_program_id);
-	CHECK_GL_PROGRAM_ERROR(floor_program_id);
+	GLuint floor_program_id = program_cache.build("floor", {
+			{ GL_VERTEX_SHADER, vertex_shader },
+			{ GL_TESS_CONTROL_SHADER, floor_tesscontrol_shader },
+			{ GL_TESS_EVALUATION_SHADER, floor_tesseval_shader },
+			{ GL_GEOMETRY_SHADER, geometry_shader },
+			{ GL_FRAGMENT_SHADER, floor_fragment_shader } });
 
 	// Get the uniform locations.
-	GLint floor_projection_matrix_location = 0;
-	CHECK_GL_ERROR(floor_projection_matrix_location =
-			glGetUniformLocation(floor_program_id, "projection"));
-	GLint floor_view_matrix_location = 0;
-	CHECK_GL_ERROR(floor_view_matrix_location =
-			glGetUniformLocation(floor_program_id, "view"));
-	GLint floor_light_position_location = 0;
-	CHECK_GL_ERROR(floor_light_position_location =
-			glGetUniformLocation(floor_program_id, "light_position"));
 	GLint floor_wireframe_location = 0;
 	CHECK_GL_ERROR(floor_wireframe_location =
 			glGetUniformLocation(floor_program_id, "wireframe"));
@@ -1118,56 +1388,29 @@ float sky_pts[] = {
 
 
 // skybox program
-	GLuint skybox_program_id = 0;
-	CHECK_GL_ERROR(skybox_program_id = glCreateProgram());
-	CHECK_GL_ERROR(glAttachShader(skybox_program_id, skybox_vertex_shader_id));
-	CHECK_GL_ERROR(glAttachShader(skybox_program_id, skybox_fragment_shader_id));
-
-	// Bind attributes.
-	CHECK_GL_ERROR(glBindAttribLocation(skybox_program_id, 0, "vertex_position"));
-	CHECK_GL_ERROR(glBindFragDataLocation(skybox_program_id, 0, "fragment_color"));
-	glLinkProgram(skybox_program_id);
-	CHECK_GL_PROGRAM_ERROR(skybox_program_id);
-
-	GLint skybox_projection_matrix_location = 0;
-	CHECK_GL_ERROR(skybox_projection_matrix_location =
-			glGetUniformLocation(skybox_program_id, "projection"));
-	GLint skybox_view_matrix_location = 0;
-	CHECK_GL_ERROR(skybox_view_matrix_location =
-			glGetUniformLocation(skybox_program_id, "view"));
+	GLuint skybox_program_id = program_cache.build("skybox", {
+			{ GL_VERTEX_SHADER, skybox_vertex_shader },
+			{ GL_FRAGMENT_SHADER, skybox_fragment_shader } });
+
 	GLint skybox_skybox_location = 0;
 	CHECK_GL_ERROR(skybox_skybox_location =
 			glGetUniformLocation(skybox_program_id, "skybox"));
+	// The sampler never changes, so set it once.
+	CHECK_GL_ERROR(glUseProgram(skybox_program_id));
+	CHECK_GL_ERROR(glUniform1i(skybox_skybox_location, 0));
 
 	
 
 
 //ocean program
-	GLuint ocean_program_id = 0;
-	CHECK_GL_ERROR(ocean_program_id = glCreateProgram());
-	CHECK_GL_ERROR(glAttachShader(ocean_program_id, vertex_shader_id));
-	CHECK_GL_ERROR(glAttachShader(ocean_program_id, ocean_fragment_shader_id));
-	CHECK_GL_ERROR(glAttachShader(ocean_program_id, ocean_tesscontrol_shader_id));
-	CHECK_GL_ERROR(glAttachShader(ocean_program_id, ocean_tesseval_shader_id));
-	CHECK_GL_ERROR(glAttachShader(ocean_program_id, ocean_geometry_shader_id));
-
-
-	// Bind attributes.
-	CHECK_GL_ERROR(glBindAttribLocation(ocean_program_id, 0, "vertex_position"));
-	CHECK_GL_ERROR(glBindFragDataLocation(ocean_program_id, 0, "fragment_color"));
-	glLinkProgram(ocean_program_id);
-	CHECK_GL_PROGRAM_ERROR(ocean_program_id);
+	GLuint ocean_program_id = program_cache.build("ocean", {
+			{ GL_VERTEX_SHADER, ocean_vertex_shader },
+			{ GL_TESS_CONTROL_SHADER, ocean_tesscontrol_shader },
+			{ GL_TESS_EVALUATION_SHADER, ocean_tesseval_shader },
+			{ GL_GEOMETRY_SHADER, ocean_geometry_shader },
+			{ GL_FRAGMENT_SHADER, ocean_fragment_shader } });
 
 	// Get the uniform locations.
-	GLint ocean_projection_matrix_location = 0;
-	CHECK_GL_ERROR(ocean_projection_matrix_location =
-			glGetUniformLocation(ocean_program_id, "projection"));
-	GLint ocean_view_matrix_location = 0;
-	CHECK_GL_ERROR(ocean_view_matrix_location =
-			glGetUniformLocation(ocean_program_id, "view"));
-	GLint ocean_light_position_location = 0;
-	CHECK_GL_ERROR(ocean_light_position_location =
-			glGetUniformLocation(ocean_program_id, "light_position"));
 	GLint ocean_wireframe_location = 0;
 	CHECK_GL_ERROR(ocean_wireframe_location =
 			glGetUniformLocation(ocean_program_id, "wireframe"));
@@ -1177,9 +1420,12 @@ float sky_pts[] = {
 	GLint ocean_tessouter_location = 0;
 	CHECK_GL_ERROR(ocean_tessouter_location =
 			glGetUniformLocation(ocean_program_id, "tess_level_outer"));
-	GLint ocean_time_location = 0;
-	CHECK_GL_ERROR(ocean_time_location =
-			glGetUniformLocation(ocean_program_id, "time"));
+	GLint ocean_ring_location = 0;
+	CHECK_GL_ERROR(ocean_ring_location =
+			glGetUniformLocation(ocean_program_id, "ring"));
+	GLint ocean_ring_inner_location = 0;
+	CHECK_GL_ERROR(ocean_ring_inner_location =
+			glGetUniformLocation(ocean_program_id, "ring_inner"));
 	GLint ocean_tidal_start_time_location = 0;
 	CHECK_GL_ERROR(ocean_tidal_start_time_location =
 			glGetUniformLocation(ocean_program_id, "tidal_start_time"));
@@ -1196,176 +1442,405 @@ float sky_pts[] = {
 	// CHECK_GL_ERROR(ocean_skybox_location =
 	// 		glGetUniformLocation(ocean_skybox_id, "skybox"));
 
+	GLuint shadow_program_id = program_cache.build("shadow", {
+			{ GL_VERTEX_SHADER, shadow_vertex_shader },
+			{ GL_FRAGMENT_SHADER, shadow_fragment_shader } });
+
+	// The sponge is the only shadow caster, and it fits in the unit cube.
+	ShadowMap shadow_map(glm::vec3(0.0f), 0.5f * std::sqrt(3.0f));
+	CHECK_GL_ERROR(glActiveTexture(GL_TEXTURE0 + kShadowMapUnit));
+	CHECK_GL_ERROR(glBindTexture(GL_TEXTURE_2D, shadow_map.texture()));
+	CHECK_GL_ERROR(glActiveTexture(GL_TEXTURE0));
+	for (GLuint program : { floor_program_id, ocean_program_id }) {
+		GLint shadow_map_location = 0;
+		CHECK_GL_ERROR(shadow_map_location =
+				glGetUniformLocation(program, "shadow_map"));
+		CHECK_GL_ERROR(glUseProgram(program));
+		CHECK_GL_ERROR(glUniform1i(shadow_map_location, kShadowMapUnit));
+	}
+
+	SetOceanUniforms(ocean_program_id);
+
+	// The uniforms describing the FFT ocean never change.
+	std::unique_ptr<OceanFFT> ocean_fft;
+	if (fft_waves)
+		ocean_fft.reset(new OceanFFT());
+	CHECK_GL_ERROR(glUseProgram(ocean_program_id));
+	GLint ocean_fft_waves_location = 0;
+	CHECK_GL_ERROR(ocean_fft_waves_location =
+			glGetUniformLocation(ocean_program_id, "fft_waves"));
+	CHECK_GL_ERROR(glUniform1i(ocean_fft_waves_location, fft_waves));
+	// Even unused, the samplers must not share unit 0 with the cubemap.
+	GLint ocean_location = 0;
+	CHECK_GL_ERROR(ocean_location =
+			glGetUniformLocation(ocean_program_id, "ocean_displacement"));
+	CHECK_GL_ERROR(glUniform1i(ocean_location, kOceanDisplacementUnit));
+	CHECK_GL_ERROR(ocean_location =
+			glGetUniformLocation(ocean_program_id, "ocean_normal"));
+	CHECK_GL_ERROR(glUniform1i(ocean_location, kOceanNormalUnit));
+	if (ocean_fft) {
+		CHECK_GL_ERROR(ocean_location =
+				glGetUniformLocation(ocean_program_id, "ocean_patch_size"));
+		CHECK_GL_ERROR(glUniform1f(ocean_location, ocean_fft->patch_size()));
+	}
+
+	// How far the waves can move the surface off its patch, so culling
+	// never drops a visible crest.
+	glm::vec2 wave_margin(0.0f, OceanAmplitude(!ocean_fft));
+	if (ocean_fft)
+		wave_margin += ocean_fft->displacement_bound();
+	CHECK_GL_ERROR(glUseProgram(ocean_program_id));
+	CHECK_GL_ERROR(ocean_location =
+			glGetUniformLocation(ocean_program_id, "wave_margin"));
+	CHECK_GL_ERROR(glUniform2fv(ocean_location, 1, &wave_margin[0]));
+
+	// Per-frame uniforms shared by all programs.
+	GLuint frame_uniform_buffer = 0;
+	CHECK_GL_ERROR(glGenBuffers(1, &frame_uniform_buffer));
+	CHECK_GL_ERROR(glBindBuffer(GL_UNIFORM_BUFFER, frame_uniform_buffer));
+	CHECK_GL_ERROR(glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms),
+				nullptr, GL_DYNAMIC_DRAW));
+	CHECK_GL_ERROR(glBindBufferBase(GL_UNIFORM_BUFFER, kFrameUniformBinding,
+				frame_uniform_buffer));
+	for (GLuint program : { program_id, floor_program_id, skybox_program_id,
+	                        ocean_program_id, shadow_program_id,
+	                        field_program_id }) {
+		GLuint block_index = 0;
+		CHECK_GL_ERROR(block_index = glGetUniformBlockIndex(program, "Frame"));
+		if (block_index != GL_INVALID_INDEX)
+			CHECK_GL_ERROR(glUniformBlockBinding(program, block_index, kFrameUniformBinding));
+	}
 
+	std::unique_ptr<FrameCapture> frame_capture(
+			new FrameCapture(capture_prefix, capture_quality));
+	bool was_recording = false;
+
+	std::unique_ptr<ReplayWriter> replay_writer;
+	std::unique_ptr<ReplayReader> replay_reader;
+	if (!replay_file.empty() && replay_playback) {
+		replay_reader.reset(new ReplayReader(replay_file));
+		CHECK_SUCCESS(replay_reader->is_open());
+	} else if (!replay_file.empty()) {
+		replay_writer.reset(new ReplayWriter(replay_file));
+		CHECK_SUCCESS(replay_writer->is_open());
+	}
+
+	// Sponge generation on the GPU, if asked for and possible.
+	std::unique_ptr<MengerGpu> menger_gpu;
+	if (gpu_generation && MengerGpu::is_supported())
+		menger_gpu.reset(new MengerGpu(program_cache));
+	else if (gpu_generation)
+		std::cerr << "Compute shaders are not supported, -G ignored\n";
+	if (menger_gpu && optimize_mesh)
+		std::cerr << "-O only applies to meshes built on the CPU\n";
+	size_t sponge_indices = 0;
+
+	SpongeField sponge_field;
+	if (field_size > 0) {
+		CreateSpongeField(sponge_field, field_size);
+		std::cout << "Sponge field: " << sponge_field.size() << " sponges in "
+		          << sponge_field.groups() << " draws\n";
+	}
 
+	RenderQueue render_queue;
+	GpuTimer gpu_timer({ "shadow", "skybox", "sponge", "floor", "ocean", "field" });
 
 	struct timespec startTime;
-	clock_gettime(CLOCK_REALTIME, &startTime);
+	clock_gettime(CLOCK_MONOTONIC, &startTime);
+	int frame = 0;
 
 	float tidal_start_time = -100.0f;
-	glm::vec4 light_position = glm::vec4(-10.0f, 10.0f, 0.0f, 1.0f);
+	glm::vec4 light_position = kLightPosition;
 	float aspect = 0.0f;
 	float theta = 0.0f;
-	while (!glfwWindowShouldClose(window)) {
+	while (headless ? frame < bench_frames : !glfwWindowShouldClose(window)) {
+		// Without animation only input changes the picture, so sleep until
+		// some arrives instead of drawing the same frame again.
+		bool animating = ocean_mode || recording || was_recording ||
+		                 gpu_timing || replay_reader || replay_writer;
+		if (!headless && !animating && !g_redraw && !g_camera.is_dirty() &&
+		    !g_menger->is_dirty()) {
+			glfwWaitEvents();
+			continue;
+		}
+		g_redraw = false;
+		g_camera.set_clean();
+		gpu_timer.set_enabled(gpu_timing);
 		// Setup some basic window stuff.
-		glfwGetFramebufferSize(window, &window_width, &window_height);
+		if (!headless)
+			glfwGetFramebufferSize(window, &window_width, &window_height);
 		glViewport(0, 0, window_width, window_height);
 		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 		glEnable(GL_DEPTH_TEST);
+		// The sky pass leaves depth writes off, and glClear obeys the mask.
+		glDepthMask(GL_TRUE);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		glDepthFunc(GL_LESS);
 
 		// Compute the projection matrix.
 		aspect = static_cast<float>(window_width) / window_height;
 		glm::mat4 projection_matrix =
-			glm::perspective(glm::radians(45.0f), aspect, 0.0001f, 1000.0f);
-
-		// Compute the view matrix
-		// FIXME: change eye and center through mouse/keyboard events.
-		glm::mat4 view_matrix = g_camera.get_view_matrix();
-
-
-		// skybox
-
-		if(skybox_mode) {
-			glDepthMask(GL_FALSE);
-			glDisable(GL_CULL_FACE);
-			glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
-
-			CHECK_GL_ERROR(glUseProgram(skybox_program_id));
-			CHECK_GL_ERROR(glUniformMatrix4fv(skybox_projection_matrix_location, 1, GL_FALSE,
-						&projection_matrix[0][0]));
-			CHECK_GL_ERROR(glUniformMatrix4fv(skybox_view_matrix_location, 1, GL_FALSE,
-						&view_matrix[0][0]));
-			CHECK_GL_ERROR(glUniform1i(glGetUniformLocation(skybox_program_id, "skybox"), 0));
-			CHECK_GL_ERROR(glActiveTexture(GL_TEXTURE0));
-			CHECK_GL_ERROR(glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap_texture));
-		 
-			CHECK_GL_ERROR(glBindVertexArray(g_array_objects[kSkyboxVao]));
-			CHECK_GL_ERROR(glPolygonMode(GL_FRONT_AND_BACK, GL_FILL));
-			CHECK_GL_ERROR(glDrawArrays(GL_TRIANGLES, 0, 36));
-		}
-		
-		CHECK_GL_ERROR(glUseProgram(program_id));
-		glEnable(GL_CULL_FACE);
-		glDepthMask(GL_TRUE);
+			glm::perspective(glm::radians(kFieldOfView), aspect, 0.0001f, 1000.0f);
 
 		struct timespec times;
-		clock_gettime(CLOCK_REALTIME, &times);
+		clock_gettime(CLOCK_MONOTONIC, &times);
 		float t = (times.tv_sec - startTime.tv_sec) + (float(times.tv_nsec - startTime.tv_nsec))/BILLION;
-		
-		if(save_obj){
-			SaveObj("geometry.obj", obj_vertices, obj_faces);
-			save_obj = false;
-		}
+		// Benchmark and replay frames are 1/60 s apart whatever their
+		// speed, so the images can be compared between runs.
+		if (headless || replay_writer || replay_reader)
+			t = frame / 60.0f;
 
 		if(save_time) {
 			tidal_start_time = t;
 			save_time = false;
 		}
+		if (replay_reader) {
+			ReplayState state;
+			if (!replay_reader->read(&g_camera, &state))
+				break;
+			LoadReplayState(state);
+			tidal_start_time = state.tidal_start_time;
+		} else if (replay_writer) {
+			replay_writer->write(g_camera, SaveReplayState(tidal_start_time));
+		}
+
+		// Compute the view matrix
+		// FIXME: change eye and center through mouse/keyboard events.
+		glm::mat4 view_matrix = g_camera.get_view_matrix();
+
+		// Upload everything the shaders share in one go.
+		FrameUniforms frame_uniforms;
+		frame_uniforms.view = view_matrix;
+		frame_uniforms.projection = projection_matrix;
+		frame_uniforms.inverse_view = glm::inverse(view_matrix);
+		frame_uniforms.view_projection = projection_matrix * view_matrix;
+		frame_uniforms.eye_position = frame_uniforms.inverse_view[3];
+		frame_uniforms.light_position = light_position;
+		frame_uniforms.viewport = glm::vec4(window_width, window_height, 0.0f, 0.0f);
+		shadow_map.set_light(light_position);
+		frame_uniforms.light_view_projection = shadow_map.light_view_projection();
+		frame_uniforms.time = t;
+		CHECK_GL_ERROR(glBindBuffer(GL_UNIFORM_BUFFER, frame_uniform_buffer));
+		CHECK_GL_ERROR(glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frame_uniforms),
+					&frame_uniforms));
+
 		// Switch to the Geometry VAO.
 		CHECK_GL_ERROR(glBindVertexArray(g_array_objects[kGeometryVao]));
-		CHECK_GL_ERROR(glBindBuffer(GL_ARRAY_BUFFER, g_buffer_objects[kGeometryVao][kVertexBuffer]));
-		CHECK_GL_ERROR(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_buffer_objects[kGeometryVao][kIndexBuffer]));
 
-		if (g_menger && g_menger->is_dirty()) {
+		if (g_menger && g_menger->is_dirty() && menger_gpu) {
+			sponge_indices = menger_gpu->generate(g_menger->get_nesting_level(),
+					g_buffer_objects[kGeometryVao][kVertexBuffer],
+					g_buffer_objects[kGeometryVao][kNormalBuffer],
+					g_buffer_objects[kGeometryVao][kIndexBuffer]);
+			g_menger->set_clean();
+			shadow_map.invalidate();
+			report_memory = report_memory || lean_memory;
+		} else if (g_menger && g_menger->is_dirty()) {
+			CHECK_GL_ERROR(glBindBuffer(GL_ARRAY_BUFFER, g_buffer_objects[kGeometryVao][kVertexBuffer]));
 			obj_vertices.clear();
+			obj_normals.clear();
 			obj_faces.clear();
-			g_menger->generate_geometry(obj_vertices, obj_faces);
+			g_menger->generate_geometry(obj_vertices, obj_normals, obj_faces);
+			if (optimize_mesh) {
+				size_t vertex_count = obj_vertices.size();
+				float acmr = ComputeAcmr(obj_faces, vertex_count);
+				// The geometry shader makes its own normals, so any two
+				// vertices in the same place can be merged.
+				WeldVertices(obj_vertices,
+						sponge_geometry_shader ? nullptr : &obj_normals,
+						obj_faces);
+				OptimizeVertexCache(obj_faces, obj_vertices.size());
+				OptimizeVertexFetch(obj_vertices,
+						sponge_geometry_shader ? nullptr : &obj_normals,
+						obj_faces);
+				if (sponge_geometry_shader)
+					obj_normals.assign(obj_vertices.size(), glm::vec4(0.0f));
+				std::cout << "Vertices " << vertex_count << " -> "
+				          << obj_vertices.size() << ", ACMR " << acmr << " -> "
+				          << ComputeAcmr(obj_faces, obj_vertices.size()) << "\n";
+			}
 			g_menger->set_clean();
+			shadow_map.invalidate();
+			sponge_indices = obj_faces.size() * 3;
 
 			CHECK_GL_ERROR(glBufferData(GL_ARRAY_BUFFER,
 				sizeof(float) * obj_vertices.size() * 4, obj_vertices.data(),
 				GL_STATIC_DRAW));
+			CHECK_GL_ERROR(glBindBuffer(GL_ARRAY_BUFFER, g_buffer_objects[kGeometryVao][kNormalBuffer]));
+			CHECK_GL_ERROR(glBufferData(GL_ARRAY_BUFFER,
+				sizeof(float) * obj_normals.size() * 4, obj_normals.data(),
+				GL_STATIC_DRAW));
 
 			CHECK_GL_ERROR(glBufferData(GL_ELEMENT_ARRAY_BUFFER,
 				sizeof(uint32_t) * obj_faces.size() * 3,
 				obj_faces.data(), GL_STATIC_DRAW));
+			// GL has its own copy now, export reads that one back.
+			if (lean_memory) {
+				std::vector<glm::vec4>().swap(obj_vertices);
+				std::vector<glm::vec4>().swap(obj_normals);
+				std::vector<glm::uvec3>().swap(obj_faces);
+				report_memory = true;
+			}
+		}
 
-			// FIXME: Upload your vertex data here.
-
+		// The shadow map is reused until the light or the sponge changes.
+		if (shadow_map.is_dirty()) {
+			gpu_timer.begin(kShadowPass);
+			shadow_map.begin();
+			CHECK_GL_ERROR(glUseProgram(shadow_program_id));
+			glEnable(GL_CULL_FACE);
+			CHECK_GL_ERROR(glPolygonMode(GL_FRONT_AND_BACK, GL_FILL));
+			CHECK_GL_ERROR(glDrawElements(GL_TRIANGLES, sponge_indices, GL_UNSIGNED_INT, 0));
+			shadow_map.end();
+			gpu_timer.end(kShadowPass);
 		}
 
+		if(save_obj){
+			bool read_back = menger_gpu || lean_memory;
+			if (read_back)
+				ReadBackGeometry(obj_vertices, obj_faces, sponge_indices);
+			SaveObj("geometry.obj", obj_vertices, obj_faces);
+			if (read_back) {
+				std::vector<glm::vec4>().swap(obj_vertices);
+				std::vector<glm::uvec3>().swap(obj_faces);
+			}
+			save_obj = false;
+		}
+		if (report_memory) {
+			ReportMemory(std::cout, obj_vertices, obj_normals, obj_faces);
+			report_memory = false;
+		}
 
+		RenderPass sponge_pass;
+		sponge_pass.timer_pass = kSpongePass;
+		sponge_pass.state.program = program_id;
+		sponge_pass.state.vao = g_array_objects[kGeometryVao];
+		sponge_pass.draw = [&]() {
+			CHECK_GL_ERROR(glDrawElements(GL_TRIANGLES, sponge_indices, GL_UNSIGNED_INT, 0));
+		};
+		render_queue.add(sponge_pass);
+
+		if (sponge_field.size() > 0) {
+			sponge_field.update();
+			// The field binds a VAO per level itself, so the pass names none.
+			RenderPass field_pass;
+			field_pass.timer_pass = kFieldPass;
+			field_pass.state.program = field_program_id;
+			field_pass.draw = [&]() {
+				sponge_field.draw();
+			};
+			render_queue.add(field_pass);
+		}
 
-		// Pass uniforms in.
-		CHECK_GL_ERROR(glUniformMatrix4fv(projection_matrix_location, 1, GL_FALSE,
-					&projection_matrix[0][0]));
-		CHECK_GL_ERROR(glUniformMatrix4fv(view_matrix_location, 1, GL_FALSE,
-					&view_matrix[0][0]));
-		CHECK_GL_ERROR(glUniform4fv(light_position_location, 1, &light_position[0]));
+		// The ocean replaces the floor.
+		RenderState surface_state;
+		surface_state.polygon_mode = toggleFaces ? GL_FILL : GL_LINE;
+		if (!ocean_mode) {
+			RenderPass floor_pass;
+			floor_pass.timer_pass = kFloorPass;
+			floor_pass.state = surface_state;
+			floor_pass.state.program = floor_program_id;
+			floor_pass.state.vao = g_array_objects[kFloorVao];
+			floor_pass.state.patch_vertices = 3;
+			floor_pass.draw = [&]() {
+				CHECK_GL_ERROR(glUniform1i(floor_wireframe_location, wireframe));
+				CHECK_GL_ERROR(glUniform1f(floor_tessouter_location, tess_level_outer));
+				CHECK_GL_ERROR(glUniform1f(floor_tessinner_location, tess_level_inner));
+				CHECK_GL_ERROR(glDrawElements(GL_PATCHES, floor_faces.size() * 3, GL_UNSIGNED_INT, 0));
+			};
+			render_queue.add(floor_pass);
+		} else {
+			RenderPass ocean_pass;
+			ocean_pass.timer_pass = kOceanPass;
+			ocean_pass.state = surface_state;
+			ocean_pass.state.program = ocean_program_id;
+			ocean_pass.state.vao = g_array_objects[kOceanVao];
+			ocean_pass.state.patch_vertices = 4;
+			ocean_pass.draw = [&]() {
+				if (ocean_fft)
+					ocean_fft->update(t);
+				CHECK_GL_ERROR(glUniform1i(ocean_wireframe_location, wireframe));
+				CHECK_GL_ERROR(glUniform1f(ocean_tessouter_location, tess_level_outer));
+				CHECK_GL_ERROR(glUniform1f(ocean_tessinner_location, tess_level_inner));
+				CHECK_GL_ERROR(glUniform1f(ocean_tidal_start_time_location, tidal_start_time));
+				CHECK_GL_ERROR(glUniform1i(ocean_skybox_mode_location, skybox_mode));
+				CHECK_GL_ERROR(glUniform1i(ocean_reflective_location, reflective));
+				CHECK_GL_ERROR(glUniform1i(ocean_transparent_location, transparent));
+
+				// One clipmap ring at a time.
+				ocean_clipmap.place(g_camera.get_eye_position(), &ocean_rings);
+				for (const auto& ring : ocean_rings) {
+					CHECK_GL_ERROR(glUniform4fv(ocean_ring_location, 1, &ring.ring[0]));
+					CHECK_GL_ERROR(glUniform3fv(ocean_ring_inner_location, 1, &ring.inner[0]));
+					CHECK_GL_ERROR(glDrawElements(GL_PATCHES, ring.count,
+								GL_UNSIGNED_INT,
+								(const void*)(ring.first * sizeof(uint32_t))));
+				}
+			};
+			render_queue.add(ocean_pass);
+		}
 
-		CHECK_GL_ERROR(glPolygonMode(GL_FRONT_AND_BACK, GL_FILL));	
-		// Draw our triangles.
-		CHECK_GL_ERROR(glDrawElements(GL_TRIANGLES, obj_faces.size() * 3, GL_UNSIGNED_INT, 0));
+		// The sky goes last and sits on the far plane, so it only shades
+		// the pixels nothing else covered.
+		if (skybox_mode) {
+			RenderPass skybox_pass;
+			skybox_pass.layer = 1;
+			skybox_pass.timer_pass = kSkyboxPass;
+			skybox_pass.state.program = skybox_program_id;
+			skybox_pass.state.vao = g_array_objects[kSkyboxVao];
+			skybox_pass.state.cull_face = false;
+			skybox_pass.state.depth_write = false;
+			skybox_pass.state.depth_func = GL_LEQUAL;
+			skybox_pass.draw = [&]() {
+				CHECK_GL_ERROR(glDrawArrays(GL_TRIANGLES, 0, 36));
+			};
+			render_queue.add(skybox_pass);
+		}
 
+		render_queue.execute(&gpu_timer);
+		gpu_timer.end_frame(std::cout);
 
-		// FIXME: Render the floor
-		// Note: What you need to do is
-		// 	1. Switch VAO
-		// 	2. Switch Program
-		// 	3. Pass Uniforms
-		// 	4. Call glDrawElements, since input geometry is
-		// 	indicated by VAO.
 
-		if(toggleFaces) {
-			CHECK_GL_ERROR(glPolygonMode(GL_FRONT_AND_BACK, GL_FILL));
-		} else {
-			CHECK_GL_ERROR(glPolygonMode(GL_FRONT_AND_BACK, GL_LINE));
+		if (recording) {
+			frame_capture->capture(window_width, window_height);
+		} else if (was_recording) {
+			frame_capture->flush();
 		}
+		was_recording = recording;
 
-		CHECK_GL_ERROR(glUseProgram(floor_program_id));
-		CHECK_GL_ERROR(glBindVertexArray(g_array_objects[kFloorVao]));
-		CHECK_GL_ERROR(glBindBuffer(GL_ARRAY_BUFFER, g_buffer_objects[kFloorVao][kVertexBuffer]));
-		CHECK_GL_ERROR(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_buffer_objects[kFloorVao][kIndexBuffer]));
-
-
-		// Pass uniforms in.
-		CHECK_GL_ERROR(glUniformMatrix4fv(floor_projection_matrix_location, 1, GL_FALSE,
-					&projection_matrix[0][0]));
-		CHECK_GL_ERROR(glUniformMatrix4fv(floor_view_matrix_location, 1, GL_FALSE,
-					&view_matrix[0][0]));
-		CHECK_GL_ERROR(glUniform4fv(floor_light_position_location, 1, &light_position[0]));
-		CHECK_GL_ERROR(glUniform1i(floor_wireframe_location, wireframe));
-		CHECK_GL_ERROR(glUniform1f(floor_tessouter_location, tess_level_outer));
-		CHECK_GL_ERROR(glUniform1f(floor_tessinner_location, tess_level_inner));
-		// Draw our triangles.
-
-		CHECK_GL_ERROR(glPatchParameteri(GL_PATCH_VERTICES, 3));
-		CHECK_GL_ERROR(glDrawElements(GL_PATCHES, floor_faces.size() * 3 * !ocean_mode, GL_UNSIGNED_INT, 0));
-
-		//ocean drawing
-		CHECK_GL_ERROR(glUseProgram(ocean_program_id));
-		CHECK_GL_ERROR(glBindVertexArray(g_array_objects[kOceanVao]));
-		CHECK_GL_ERROR(glBindBuffer(GL_ARRAY_BUFFER, g_buffer_objects[kOceanVao][kVertexBuffer]));
-		CHECK_GL_ERROR(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_buffer_objects[kOceanVao][kIndexBuffer]));
-
-		// Pass uniforms in.
-		CHECK_GL_ERROR(glUniformMatrix4fv(ocean_projection_matrix_location, 1, GL_FALSE,
-					&projection_matrix[0][0]));
-		CHECK_GL_ERROR(glUniformMatrix4fv(ocean_view_matrix_location, 1, GL_FALSE,
-					&view_matrix[0][0]));
-		CHECK_GL_ERROR(glUniform4fv(ocean_light_position_location, 1, &light_position[0]));
-		CHECK_GL_ERROR(glUniform1i(ocean_wireframe_location, wireframe));
-		CHECK_GL_ERROR(glUniform1f(ocean_tessouter_location, tess_level_outer));
-		CHECK_GL_ERROR(glUniform1f(ocean_tessinner_location, tess_level_inner));
-		CHECK_GL_ERROR(glUniform1f(ocean_tidal_start_time_location, tidal_start_time));
-		CHECK_GL_ERROR(glUniform1i(ocean_skybox_mode_location, skybox_mode));
-		CHECK_GL_ERROR(glUniform1i(ocean_reflective_location, reflective));
-		CHECK_GL_ERROR(glUniform1i(ocean_transparent_location, transparent));
-
-		CHECK_GL_ERROR(glUniform1f(ocean_time_location, t));
-
-		// Draw our triangles.
-		CHECK_GL_ERROR(glPatchParameteri(GL_PATCH_VERTICES, 4));
-		CHECK_GL_ERROR(glDrawElements(GL_PATCHES, ocean_faces.size() * 4 * ocean_mode, GL_UNSIGNED_INT, 0));
-
-
+		++frame;
+		if (headless)
+			continue;
 		// Poll and swap.
 		glfwPollEvents();
 
 		glfwSwapBuffers(window);
 	}
+	if (headless) {
+		CHECK_GL_ERROR(glFinish());
+		struct timespec end_time;
+		clock_gettime(CLOCK_MONOTONIC, &end_time);
+		double seconds = (end_time.tv_sec - startTime.tv_sec) +
+			double(end_time.tv_nsec - startTime.tv_nsec) / BILLION;
+		std::cout << "frames," << frame << "\nseconds," << seconds
+		          << "\nfps," << frame / seconds << "\n";
+		gpu_timer.report(std::cout);
+		if (!bench_image.empty()) {
+			std::vector<unsigned char> pixels(window_width * window_height * 3);
+			CHECK_GL_ERROR(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+			CHECK_GL_ERROR(glReadPixels(0, 0, window_width, window_height,
+						GL_RGB, GL_UNSIGNED_BYTE, pixels.data()));
+			if (!SaveJPEG(bench_image, window_width, window_height, pixels.data()))
+				std::cerr << "Failed to write " << bench_image << "\n";
+		}
+	}
+	// Finish encoding while the PBOs still have a context.
+	frame_capture.reset();
+	replay_writer.reset();
+	if (headless) {
+		headless_context.reset();
+		exit(EXIT_SUCCESS);
+	}
 	glfwDestroyWindow(window);
 	glfwTerminate();
 	exit(EXIT_SUCCESS);
@@ -1,4 +1,6 @@
 #include "menger.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 namespace {
@@ -22,6 +24,12 @@ Menger::set_nesting_level(int level)
 	dirty_ = true;
 }
 
+int
+Menger::get_nesting_level() const
+{
+	return nesting_level_;
+}
+
 bool
 Menger::is_dirty() const
 {
@@ -34,8 +42,12 @@ Menger::set_clean()
 	dirty_ = false;
 }
 
+// Each face is split along a diagonal through its own corner, which ends
+// both of its triangles and carries its normal: -x 0, -z 1, -y 3, +z 4,
+// +y 5, +x 6. Triangles are counter-clockwise seen from outside.
 void
 create_cube(std::vector<glm::vec4>& vertices,
+                    std::vector<glm::vec4>* normals,
                     std::vector<glm::uvec3>& faces,
                     glm::vec3 min, glm::vec3 max)
 {
@@ -50,30 +62,41 @@ create_cube(std::vector<glm::vec4>& vertices,
 	vertices.push_back(glm::vec4(max.x, max.y, max.z, 1.0f)); // 6
 	vertices.push_back(glm::vec4(max.x, min.y, max.z, 1.0f)); // 7
 
+	if (normals) {
+		normals->push_back(glm::vec4(-1.0f, 0.0f, 0.0f, 0.0f));
+		normals->push_back(glm::vec4(0.0f, 0.0f, -1.0f, 0.0f));
+		normals->push_back(glm::vec4(0.0f));
+		normals->push_back(glm::vec4(0.0f, -1.0f, 0.0f, 0.0f));
+		normals->push_back(glm::vec4(0.0f, 0.0f, 1.0f, 0.0f));
+		normals->push_back(glm::vec4(0.0f, 1.0f, 0.0f, 0.0f));
+		normals->push_back(glm::vec4(1.0f, 0.0f, 0.0f, 0.0f));
+		normals->push_back(glm::vec4(0.0f));
+	}
 
-	faces.push_back(offset + glm::uvec3(0, 1, 2)); // 0
-	faces.push_back(offset + glm::uvec3(0, 2, 3)); // 1
-	faces.push_back(offset + glm::uvec3(1, 5, 6)); // 2
-	faces.push_back(offset + glm::uvec3(1, 6, 2)); // 3
-	faces.push_back(offset + glm::uvec3(3, 2, 6)); // 4
-	faces.push_back(offset + glm::uvec3(3, 6, 7)); // 5
-	faces.push_back(offset + glm::uvec3(6, 5, 4)); // 6
-	faces.push_back(offset + glm::uvec3(6, 4, 7)); // 7
-	faces.push_back(offset + glm::uvec3(5, 1, 0)); // 8
-	faces.push_back(offset + glm::uvec3(5, 0, 4)); // 9
-	faces.push_back(offset + glm::uvec3(4, 3, 7)); // 10
+	faces.push_back(offset + glm::uvec3(2, 3, 1)); // 0
+	faces.push_back(offset + glm::uvec3(3, 0, 1)); // 1
+	faces.push_back(offset + glm::uvec3(6, 2, 5)); // 2
+	faces.push_back(offset + glm::uvec3(2, 1, 5)); // 3
+	faces.push_back(offset + glm::uvec3(7, 3, 6)); // 4
+	faces.push_back(offset + glm::uvec3(3, 2, 6)); // 5
+	faces.push_back(offset + glm::uvec3(7, 6, 4)); // 6
+	faces.push_back(offset + glm::uvec3(6, 5, 4)); // 7
+	faces.push_back(offset + glm::uvec3(4, 5, 0)); // 8
+	faces.push_back(offset + glm::uvec3(5, 1, 0)); // 9
+	faces.push_back(offset + glm::uvec3(7, 4, 3)); // 10
 	faces.push_back(offset + glm::uvec3(4, 0, 3)); // 11
 
 }
 
 void
 create_sponge(std::vector<glm::vec4>& vertices,
+                    std::vector<glm::vec4>* normals,
                     std::vector<glm::uvec3>& faces,
                     glm::vec3 min, glm::vec3 max,
                     int depth)
 {
 	if(depth == 0){
-		create_cube(vertices, faces, min, max);
+		create_cube(vertices, normals, faces, min, max);
 		return;
 	}
 
@@ -96,7 +119,7 @@ create_sponge(std::vector<glm::vec4>& vertices,
 				glm::vec3 newmax = newmin + side * glm::vec3(1.0f, 1.0f, 1.0f);
 				// printf("min %s\n", glm::to_string(newmin));
 				// printf("max %s\n", glm::to_string(newmax));
-				create_sponge(vertices, faces, newmin, newmax, depth-1);
+				create_sponge(vertices, normals, faces, newmin, newmax, depth-1);
 			}
 		}
 	}
@@ -104,12 +127,93 @@ create_sponge(std::vector<glm::vec4>& vertices,
 
 }
 
+// The 7 removed sub-cubes have at least two middle coordinates.
+bool
+is_kept(int x, int y, int z)
+{
+	return (x == 1) + (y == 1) + (z == 1) < 2;
+}
+
+// Looks for solid of the cube at min in the sphere, only descending into
+// the kept sub-cubes the sphere reaches.
+bool
+sphere_hits_cube(const glm::vec3& center, float radius,
+                 glm::vec3 min, float size, int depth)
+{
+	glm::vec3 max = min + glm::vec3(size);
+	glm::vec3 nearest = glm::max(min, glm::min(center, max));
+	if (glm::dot(nearest - center, nearest - center) > radius * radius)
+		return false;
+	// Cube corners are solid at every level, so a corner in the sphere
+	// settles it.
+	glm::vec3 farthest;
+	for (int i = 0; i < 3; ++i)
+		farthest[i] = center[i] - min[i] > max[i] - center[i] ? min[i] : max[i];
+	glm::vec3 nearest_corner = min + max - farthest;
+	if (depth == 0 ||
+	    glm::dot(nearest_corner - center, nearest_corner - center) <= radius * radius)
+		return true;
+
+	// Only the sub-cubes under the sphere's bounding box.
+	float side = size / 3.0f;
+	glm::ivec3 first, last;
+	for (int i = 0; i < 3; ++i) {
+		first[i] = std::max(int(std::floor((center[i] - radius - min[i]) / side)), 0);
+		last[i] = std::min(int(std::floor((center[i] + radius - min[i]) / side)), 2);
+	}
+	for (int x = first.x; x <= last.x; ++x)
+		for (int y = first.y; y <= last.y; ++y)
+			for (int z = first.z; z <= last.z; ++z)
+				if (is_kept(x, y, z) &&
+				    sphere_hits_cube(center, radius,
+				                     min + side * glm::vec3(x, y, z), side,
+				                     depth - 1))
+					return true;
+	return false;
+}
+
 // FIXME generate Menger sponge geometry
 void
 Menger::generate_geometry(std::vector<glm::vec4>& vertices,
                           std::vector<glm::uvec3>& faces) const
 {
-	create_sponge(vertices, faces, glm::vec3(-.5f,-.5f,-.5f), glm::vec3(.5f,.5f,.5f), nesting_level_);
+	create_sponge(vertices, nullptr, faces, glm::vec3(-.5f,-.5f,-.5f), glm::vec3(.5f,.5f,.5f), nesting_level_);
 	// printf("asdfasdf\n");
 }
 
+void
+Menger::generate_geometry(std::vector<glm::vec4>& vertices,
+                          std::vector<glm::vec4>& normals,
+                          std::vector<glm::uvec3>& faces) const
+{
+	create_sponge(vertices, &normals, faces, glm::vec3(-.5f,-.5f,-.5f), glm::vec3(.5f,.5f,.5f), nesting_level_);
+}
+
+bool
+Menger::contains(const glm::vec3& p) const
+{
+	glm::vec3 u = p + glm::vec3(0.5f);
+	for (int i = 0; i < 3; ++i)
+		if (u[i] < 0.0f || u[i] > 1.0f)
+			return false;
+	for (int level = 0; level < nesting_level_; ++level) {
+		u *= 3.0f;
+		glm::ivec3 digit;
+		for (int i = 0; i < 3; ++i) {
+			digit[i] = std::min(int(u[i]), 2);
+			u[i] -= digit[i];
+		}
+		if (!is_kept(digit.x, digit.y, digit.z))
+			return false;
+	}
+	return true;
+}
+
+bool
+Menger::intersects_sphere(const glm::vec3& center, float radius) const
+{
+	// Most positive answers are settled by the center alone.
+	return contains(center) ||
+	       sphere_hits_cube(center, radius, glm::vec3(-0.5f), 1.0f,
+	                        nesting_level_);
+}
@@ -9,10 +9,22 @@ public:
 	Menger();
 	~Menger();
 	void set_nesting_level(int);
+	int get_nesting_level() const;
 	bool is_dirty() const;
 	void set_clean();
 	void generate_geometry(std::vector<glm::vec4>& obj_vertices,
 	                       std::vector<glm::uvec3>& obj_faces) const;
+	// Also emits a face normal per vertex, valid as the last (provoking)
+	// vertex of every triangle, for flat shading without a geometry shader.
+	void generate_geometry(std::vector<glm::vec4>& obj_vertices,
+	                       std::vector<glm::vec4>& obj_normals,
+	                       std::vector<glm::uvec3>& obj_faces) const;
+	// True if p is in the solid of the sponge, the cube [-0.5, 0.5]^3 at
+	// the current level. Reads one base-3 digit of each coordinate per
+	// level, so it is O(level) and needs no mesh.
+	bool contains(const glm::vec3& p) const;
+	// True if the sphere overlaps the solid.
+	bool intersects_sphere(const glm::vec3& center, float radius) const;
 private:
 	int nesting_level_ = 0;
 	bool dirty_ = false;
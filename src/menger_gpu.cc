@@ -0,0 +1,142 @@
+#include "menger_gpu.h"
+#include <algorithm>
+#include <debuggl.h>
+#include <gl_util.h>
+#include <iostream>
+#include <stdint.h>
+
+#include "program_cache.h"
+
+namespace {
+	const GLuint kGroupSize = 64;
+	const GLuint kMaxGroups = 65535;
+
+	const char* kComputeShader = R"zzz(
+layout(local_size_x = 64) in;
+layout(std430, binding = 0) writeonly buffer Vertices { vec4 vertices[]; };
+layout(std430, binding = 1) writeonly buffer Normals { vec4 normals[]; };
+layout(std430, binding = 2) writeonly buffer Indices { uint indices[]; };
+uniform uint leaf_count;
+uniform int level;
+
+// The 20 sub-cubes create_sponge keeps, in the order it visits them.
+const uvec3 kCells[20] = uvec3[20](
+	uvec3(0, 0, 0), uvec3(0, 0, 1), uvec3(0, 0, 2),
+	uvec3(0, 1, 0), uvec3(0, 1, 2),
+	uvec3(0, 2, 0), uvec3(0, 2, 1), uvec3(0, 2, 2),
+	uvec3(1, 0, 0), uvec3(1, 0, 2),
+	uvec3(1, 2, 0), uvec3(1, 2, 2),
+	uvec3(2, 0, 0), uvec3(2, 0, 1), uvec3(2, 0, 2),
+	uvec3(2, 1, 0), uvec3(2, 1, 2),
+	uvec3(2, 2, 0), uvec3(2, 2, 1), uvec3(2, 2, 2));
+
+// Corners, normals and triangles of create_cube.
+const vec3 kCorners[8] = vec3[8](
+	vec3(0, 0, 0), vec3(0, 1, 0), vec3(1, 1, 0), vec3(1, 0, 0),
+	vec3(0, 0, 1), vec3(0, 1, 1), vec3(1, 1, 1), vec3(1, 0, 1));
+const vec3 kNormals[8] = vec3[8](
+	vec3(-1, 0, 0), vec3(0, 0, -1), vec3(0), vec3(0, -1, 0),
+	vec3(0, 0, 1), vec3(0, 1, 0), vec3(1, 0, 0), vec3(0));
+const uint kTriangles[36] = uint[36](
+	2, 3, 1,  3, 0, 1,  6, 2, 5,  2, 1, 5,  7, 3, 6,  3, 2, 6,
+	7, 6, 4,  6, 5, 4,  4, 5, 0,  5, 1, 0,  7, 4, 3,  4, 0, 3);
+
+void main()
+{
+	uint leaf = (gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x) *
+	            gl_WorkGroupSize.x + gl_LocalInvocationID.x;
+	if (leaf >= leaf_count)
+		return;
+
+	// Most significant digit first, like the recursion.
+	vec3 lo = vec3(-0.5f);
+	vec3 hi = vec3(0.5f);
+	uint place = leaf_count / 20u;
+	uint rest = leaf;
+	for (int l = 0; l < level; ++l) {
+		uint digit = rest / place;
+		rest -= digit * place;
+		place /= 20u;
+		float side = (hi.x - lo.x) / 3.0f;
+		lo += side * vec3(kCells[digit]);
+		hi = lo + vec3(side);
+	}
+
+	uint first_vertex = leaf * 8u;
+	for (int i = 0; i < 8; ++i) {
+		vertices[first_vertex + i] = vec4(mix(lo, hi, kCorners[i]), 1.0f);
+		normals[first_vertex + i] = vec4(kNormals[i], 0.0f);
+	}
+	uint first_index = leaf * 36u;
+	for (int i = 0; i < 36; ++i)
+		indices[first_index + i] = first_vertex + kTriangles[i];
+}
+)zzz";
+
+	bool has_gl43()
+	{
+		GLint major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		return major > 4 || (major == 4 && minor >= 3);
+	}
+};
+
+bool
+MengerGpu::is_supported()
+{
+	return has_gl43() || (HasGLExtension("GL_ARB_compute_shader") &&
+	                      HasGLExtension("GL_ARB_shader_storage_buffer_object"));
+}
+
+MengerGpu::MengerGpu(ProgramCache& program_cache)
+{
+	if (has_gl43())
+		source_ = "#version 430 core\n";
+	else
+		source_ = "#version 400 core\n"
+		          "#extension GL_ARB_compute_shader : require\n"
+		          "#extension GL_ARB_shader_storage_buffer_object : require\n";
+	source_ += kComputeShader;
+	program_ = program_cache.build("menger_gpu",
+			{ { GL_COMPUTE_SHADER, source_.c_str() } }, {});
+	CHECK_GL_ERROR(leaf_count_location_ =
+			glGetUniformLocation(program_, "leaf_count"));
+	CHECK_GL_ERROR(level_location_ =
+			glGetUniformLocation(program_, "level"));
+}
+
+size_t
+MengerGpu::generate(int level, GLuint vertex_buffer, GLuint normal_buffer,
+                    GLuint index_buffer)
+{
+	GLuint leaves = 1;
+	for (int l = 0; l < level; ++l)
+		leaves *= 20;
+
+	const GLsizeiptr sizes[3] = {
+		GLsizeiptr(leaves) * GLsizeiptr(8 * 4 * sizeof(float)),
+		GLsizeiptr(leaves) * GLsizeiptr(8 * 4 * sizeof(float)),
+		GLsizeiptr(leaves) * GLsizeiptr(36 * sizeof(uint32_t))
+	};
+	const GLuint buffers[3] = { vertex_buffer, normal_buffer, index_buffer };
+	for (int i = 0; i < 3; ++i) {
+		CHECK_GL_ERROR(glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[i]));
+		CHECK_GL_ERROR(glBufferData(GL_SHADER_STORAGE_BUFFER, sizes[i],
+					nullptr, GL_STATIC_DRAW));
+		CHECK_GL_ERROR(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, buffers[i]));
+	}
+
+	CHECK_GL_ERROR(glUseProgram(program_));
+	CHECK_GL_ERROR(glUniform1ui(leaf_count_location_, leaves));
+	CHECK_GL_ERROR(glUniform1i(level_location_, level));
+	// Past 65535 groups the rest wrap into a second dimension.
+	GLuint groups = (leaves + kGroupSize - 1) / kGroupSize;
+	GLuint groups_x = std::min(groups, kMaxGroups);
+	GLuint groups_y = (groups + groups_x - 1) / groups_x;
+	CHECK_GL_ERROR(glDispatchCompute(groups_x, groups_y, 1));
+	// The draws read the results as attributes and indices.
+	CHECK_GL_ERROR(glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT |
+				GL_ELEMENT_ARRAY_BARRIER_BIT));
+	return size_t(leaves) * 36;
+}
@@ -0,0 +1,37 @@
+#ifndef MENGER_GPU_H
+#define MENGER_GPU_H
+
+#include <GL/glew.h>
+#include <stddef.h>
+#include <string>
+
+class ProgramCache;
+
+/*
+ * Builds the sponge of Menger::generate_geometry with a compute shader,
+ * straight into GL buffers, so the mesh never exists on the CPU.
+ *
+ * There is one invocation per leaf cube. The base-20 digits of its index
+ * pick one of the 20 kept sub-cubes at every level, in the order
+ * create_sponge visits them, so the buffers hold the same vertices, normals
+ * and triangles as the CPU path, in the same order.
+ *
+ * Needs GL 4.3, or ARB_compute_shader and ARB_shader_storage_buffer_object.
+ */
+class MengerGpu {
+public:
+	// False if the context cannot run the generator.
+	static bool is_supported();
+	explicit MengerGpu(ProgramCache& program_cache);
+	// Reallocates the three buffers for the given level and fills them.
+	// Returns the number of indices.
+	size_t generate(int level, GLuint vertex_buffer, GLuint normal_buffer,
+	                GLuint index_buffer);
+private:
+	std::string source_;
+	GLuint program_ = 0;
+	GLint leaf_count_location_ = -1;
+	GLint level_location_ = -1;
+};
+
+#endif
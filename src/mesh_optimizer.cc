@@ -0,0 +1,231 @@
+#include "mesh_optimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdint.h>
+
+namespace {
+	struct WeldKey {
+		int64_t position[3];
+		float normal[3];
+
+		bool operator<(const WeldKey& other) const
+		{
+			for (int i = 0; i < 3; ++i)
+				if (position[i] != other.position[i])
+					return position[i] < other.position[i];
+			for (int i = 0; i < 3; ++i)
+				if (normal[i] != other.normal[i])
+					return normal[i] < other.normal[i];
+			return false;
+		}
+	};
+
+	template <typename T>
+	void permute(std::vector<T>& values, const std::vector<uint32_t>& new_index,
+	             size_t new_size)
+	{
+		std::vector<T> result(new_size);
+		for (size_t i = 0; i < values.size(); ++i)
+			if (new_index[i] != UINT32_MAX)
+				result[new_index[i]] = values[i];
+		values.swap(result);
+	}
+
+	// For every vertex, the lowest index with an equal key. Sorting finds
+	// the duplicates, and the result does not depend on the sort.
+	std::vector<uint32_t> first_equal(const std::vector<WeldKey>& keys)
+	{
+		std::vector<uint32_t> order(keys.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b) {
+			if (keys[a] < keys[b])
+				return true;
+			if (keys[b] < keys[a])
+				return false;
+			return a < b;
+		});
+		std::vector<uint32_t> first(keys.size());
+		for (size_t i = 0; i < order.size(); ++i) {
+			bool new_key = i == 0 || keys[order[i - 1]] < keys[order[i]];
+			first[order[i]] = new_key ? order[i] : first[order[i - 1]];
+		}
+		return first;
+	}
+
+	void remap_faces(std::vector<glm::uvec3>& faces,
+	                 const std::vector<uint32_t>& new_index)
+	{
+		for (auto& face : faces)
+			for (int i = 0; i < 3; ++i)
+				face[i] = new_index[face[i]];
+	}
+};
+
+void
+WeldVertices(std::vector<glm::vec4>& vertices,
+             std::vector<glm::vec4>* normals,
+             std::vector<glm::uvec3>& faces,
+             float tolerance)
+{
+	size_t count = vertices.size();
+	std::vector<WeldKey> keys(count);
+	for (size_t i = 0; i < count; ++i) {
+		for (int c = 0; c < 3; ++c) {
+			keys[i].position[c] = int64_t(std::floor(vertices[i][c] / tolerance + 0.5f));
+			keys[i].normal[c] = 0.0f;
+		}
+	}
+	std::vector<uint32_t> same_position = first_equal(keys);
+	std::vector<uint32_t> same_normal = same_position;
+	if (normals) {
+		for (size_t i = 0; i < count; ++i)
+			for (int c = 0; c < 3; ++c)
+				keys[i].normal[c] = (*normals)[i][c];
+		same_normal = first_equal(keys);
+	}
+
+	// Only the last vertex of a triangle needs its own normal, so vertices
+	// never last, those without a normal, can be any in the same place.
+	for (auto& face : faces) {
+		for (int i = 0; i < 3; ++i) {
+			bool free = normals && (*normals)[face[i]] == glm::vec4(0.0f);
+			face[i] = free ? same_position[face[i]] : same_normal[face[i]];
+		}
+	}
+
+	// Keep the vertices still used, in their original order.
+	std::vector<uint32_t> new_index(count, UINT32_MAX);
+	for (const auto& face : faces)
+		for (int i = 0; i < 3; ++i)
+			new_index[face[i]] = 0;
+	uint32_t welded = 0;
+	for (size_t i = 0; i < count; ++i)
+		if (new_index[i] != UINT32_MAX)
+			new_index[i] = welded++;
+	remap_faces(faces, new_index);
+	permute(vertices, new_index, welded);
+	if (normals)
+		permute(*normals, new_index, welded);
+}
+
+// Tipsify: fans out around one vertex at a time, and moves on to the
+// neighbour that will stay in the cache the longest. It is a heuristic, so
+// an order that already does better is kept.
+void
+OptimizeVertexCache(std::vector<glm::uvec3>& faces, size_t vertex_count,
+                    int cache_size)
+{
+	// Triangles around each vertex, as offsets into one array.
+	std::vector<uint32_t> first(vertex_count + 1, 0);
+	for (const auto& face : faces)
+		for (int i = 0; i < 3; ++i)
+			++first[face[i] + 1];
+	std::partial_sum(first.begin(), first.end(), first.begin());
+	std::vector<uint32_t> adjacency(first.back());
+	std::vector<uint32_t> fill(first.begin(), first.end() - 1);
+	for (size_t t = 0; t < faces.size(); ++t)
+		for (int i = 0; i < 3; ++i)
+			adjacency[fill[faces[t][i]]++] = t;
+
+	// live is the number of triangles left to emit around each vertex.
+	std::vector<uint32_t> live(vertex_count);
+	for (size_t v = 0; v < vertex_count; ++v)
+		live[v] = first[v + 1] - first[v];
+	std::vector<int64_t> cache_time(vertex_count, 0);
+	std::vector<bool> emitted(faces.size(), false);
+	std::vector<uint32_t> dead_end;
+	std::vector<uint32_t> candidates;
+	std::vector<glm::uvec3> result;
+	result.reserve(faces.size());
+	int64_t time = cache_size + 1;
+	size_t cursor = 0;
+
+	int64_t fan = vertex_count > 0 ? 0 : -1;
+	while (fan >= 0) {
+		candidates.clear();
+		for (uint32_t a = first[fan]; a < first[fan + 1]; ++a) {
+			uint32_t t = adjacency[a];
+			if (emitted[t])
+				continue;
+			result.push_back(faces[t]);
+			for (int i = 0; i < 3; ++i) {
+				uint32_t v = faces[t][i];
+				dead_end.push_back(v);
+				candidates.push_back(v);
+				--live[v];
+				if (time - cache_time[v] > cache_size)
+					cache_time[v] = time++;
+			}
+			emitted[t] = true;
+		}
+
+		// The candidate whose fan fits in the cache and that entered it
+		// first, before it would be evicted.
+		fan = -1;
+		int64_t best = -1;
+		for (uint32_t v : candidates) {
+			if (live[v] == 0)
+				continue;
+			int64_t priority = 0;
+			if (time - cache_time[v] + 2 * live[v] <= cache_size)
+				priority = time - cache_time[v];
+			if (priority > best) {
+				best = priority;
+				fan = v;
+			}
+		}
+		if (fan >= 0)
+			continue;
+		// Nothing useful in the cache: back to a recent vertex, or the next
+		// one with triangles left.
+		while (!dead_end.empty() && fan < 0) {
+			uint32_t v = dead_end.back();
+			dead_end.pop_back();
+			if (live[v] > 0)
+				fan = v;
+		}
+		for (; fan < 0 && cursor < vertex_count; ++cursor)
+			if (live[cursor] > 0)
+				fan = cursor;
+	}
+	if (ComputeAcmr(result, vertex_count, cache_size) <
+	    ComputeAcmr(faces, vertex_count, cache_size))
+		faces.swap(result);
+}
+
+void
+OptimizeVertexFetch(std::vector<glm::vec4>& vertices,
+                    std::vector<glm::vec4>* normals,
+                    std::vector<glm::uvec3>& faces)
+{
+	std::vector<uint32_t> new_index(vertices.size(), UINT32_MAX);
+	uint32_t next = 0;
+	for (const auto& face : faces)
+		for (int i = 0; i < 3; ++i)
+			if (new_index[face[i]] == UINT32_MAX)
+				new_index[face[i]] = next++;
+	remap_faces(faces, new_index);
+	// Vertices no triangle uses are dropped.
+	permute(vertices, new_index, next);
+	if (normals)
+		permute(*normals, new_index, next);
+}
+
+float
+ComputeAcmr(const std::vector<glm::uvec3>& faces, size_t vertex_count,
+            int cache_size)
+{
+	if (faces.empty())
+		return 0.0f;
+	// A FIFO cache: a vertex is in it until cache_size misses later.
+	std::vector<int64_t> cache_time(vertex_count, -int64_t(cache_size) - 1);
+	int64_t misses = 0;
+	for (const auto& face : faces) {
+		for (int i = 0; i < 3; ++i) {
+			if (misses - cache_time[face[i]] > cache_size)
+				cache_time[face[i]] = misses++;
+		}
+	}
+	return float(misses) / faces.size();
+}
@@ -0,0 +1,43 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// Post-transform cache size the orderings aim at and ACMR is measured with.
+const int kVertexCacheSize = 16;
+
+/*
+ * Reorders an indexed triangle mesh so that GPUs run the vertex shader
+ * fewer times per triangle, without changing what is drawn.
+ *
+ * The sponge's cubes are separate and come out in recursion order, so
+ * vertices are only reused inside a cube. Welding shares the corners of
+ * neighbouring cubes, OptimizeVertexCache then orders the triangles with
+ * Tipsify (Sander, Nehab and Barczak 2007) so shared vertices are still in
+ * the cache when they come around again, and OptimizeVertexFetch stores
+ * the vertices in the order they are first used.
+ *
+ * The vertices of every triangle keep their order, so the last one is
+ * still the provoking vertex carrying the face normal.
+ */
+
+// Merges vertices closer than tolerance in every coordinate. If normals
+// are given, the last vertex of each triangle is only merged with ones of
+// the same normal, as it is the one flat shading reads it from.
+void WeldVertices(std::vector<glm::vec4>& vertices,
+                  std::vector<glm::vec4>* normals,
+                  std::vector<glm::uvec3>& faces,
+                  float tolerance = 1e-5f);
+// Never raises the ACMR, the order is left alone if Tipsify cannot beat it.
+void OptimizeVertexCache(std::vector<glm::uvec3>& faces, size_t vertex_count,
+                         int cache_size = kVertexCacheSize);
+void OptimizeVertexFetch(std::vector<glm::vec4>& vertices,
+                         std::vector<glm::vec4>* normals,
+                         std::vector<glm::uvec3>& faces);
+// Average cache miss ratio, vertex shader runs per triangle with a FIFO
+// cache: 3 without reuse, 0.5 at best for large regular meshes.
+float ComputeAcmr(const std::vector<glm::uvec3>& faces, size_t vertex_count,
+                  int cache_size = kVertexCacheSize);
+
+#endif
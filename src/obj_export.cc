@@ -0,0 +1,22 @@
+#include "obj_export.h"
+#include <fstream>
+#include <iostream>
+
+bool
+SaveObj(const std::string& file,
+        const std::vector<glm::vec4>& vertices,
+        const std::vector<glm::uvec3>& indices)
+{
+	std::ofstream f(file);
+	// '\n' rather than std::endl, a flush per line dominated the export.
+	for (auto &v : vertices)
+		f << "v " << v.x << " " << v.y << " " << v.z << "\n";
+	for (auto &i : indices)
+		f << "f " << (i.x + 1) << " " << (i.y + 1) << " " << (i.z + 1) << "\n";
+	f.close();
+	if (!f) {
+		std::cerr << "Failed to write " << file << "\n";
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,13 @@
+#ifndef OBJ_EXPORT_H
+#define OBJ_EXPORT_H
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Writes positions and triangles as a Wavefront OBJ file.
+bool SaveObj(const std::string& file,
+             const std::vector<glm::vec4>& vertices,
+             const std::vector<glm::uvec3>& indices);
+
+#endif
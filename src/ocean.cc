@@ -0,0 +1,122 @@
+#include "ocean.h"
+#include <algorithm>
+#include <cmath>
+
+const Wave kWaves[kNumWaves] = {
+	{ glm::vec2(1.0f, 0.0f), 0.5f, 2.0f, 0.4f },
+	{ glm::vec2(0.70710678f, 0.70710678f), 0.8f, 2.0f, 0.5f },
+};
+
+namespace {
+	// Points per thread work item, small enough to stay in L1.
+	const size_t kBlockSize = 256;
+	// The shader's value of pi.
+	const float kTidalPi = 3.14159f;
+
+	// Same expressions, in the same order, as vertexHeight, vertexNormal,
+	// tidalHeight and tidalNormal in the shader.
+	void evaluate_block(const float* __restrict x, const float* __restrict z,
+	                    float* __restrict height, float* __restrict nx,
+	                    float* __restrict ny, float* __restrict nz,
+	                    size_t count, float t, float tidal_time)
+	{
+		#pragma omp simd
+		for (size_t i = 0; i < count; ++i) {
+			height[i] = kOceanLevel;
+			nx[i] = 0.0f;
+			nz[i] = 0.0f;
+		}
+		for (const Wave& wave : kWaves) {
+			const float dx = wave.direction.x, dz = wave.direction.y;
+			const float f = wave.frequency, a = wave.amplitude;
+			const float offset = t * wave.speed * f;
+			#pragma omp simd
+			for (size_t i = 0; i < count; ++i) {
+				float phase = (dx * x[i] + dz * z[i]) * f + offset;
+				height[i] += a * std::sin(phase);
+				float d = f * a * std::cos(phase);
+				nx[i] -= dx * d;
+				nz[i] -= dz * d;
+			}
+		}
+		const float w2 = kTidalWidth * kTidalWidth;
+		const float height_scale = kTidalHeight / (2 * kTidalPi * w2);
+		const float slope_scale = kTidalHeight / (2 * kTidalPi * w2 * w2);
+		#pragma omp simd
+		for (size_t i = 0; i < count; ++i) {
+			float px = x[i] - tidal_time;
+			float e = std::exp(-(px * px + z[i] * z[i]) / (2 * w2));
+			height[i] += height_scale * e;
+			float d = -slope_scale * e;
+			nx[i] -= px * d;
+			nz[i] -= z[i] * d;
+		}
+		#pragma omp simd
+		for (size_t i = 0; i < count; ++i) {
+			float inverse_length = 1.0f / std::sqrt(nx[i] * nx[i] + 1.0f + nz[i] * nz[i]);
+			nx[i] *= inverse_length;
+			ny[i] = inverse_length;
+			nz[i] *= inverse_length;
+		}
+	}
+};
+
+void
+OceanPoints::resize(size_t size)
+{
+	x.resize(size);
+	z.resize(size);
+	height.resize(size);
+	normal_x.resize(size);
+	normal_y.resize(size);
+	normal_z.resize(size);
+}
+
+size_t
+OceanPoints::size() const
+{
+	return x.size();
+}
+
+void
+EvaluateOcean(OceanPoints* points, float t, float tidal_time)
+{
+	const size_t count = points->size();
+	points->resize(count);
+	const long blocks = (count + kBlockSize - 1) / kBlockSize;
+	#pragma omp parallel for schedule(static) if (blocks > 1)
+	for (long block = 0; block < blocks; ++block) {
+		size_t begin = block * kBlockSize;
+		size_t size = std::min(kBlockSize, count - begin);
+		evaluate_block(&points->x[begin], &points->z[begin],
+		               &points->height[begin], &points->normal_x[begin],
+		               &points->normal_y[begin], &points->normal_z[begin],
+		               size, t, tidal_time);
+	}
+}
+
+float
+OceanAmplitude(bool with_waves)
+{
+	float amplitude = kTidalHeight / (2 * kTidalPi * kTidalWidth * kTidalWidth);
+	for (const Wave& wave : kWaves)
+		amplitude += with_waves ? std::abs(wave.amplitude) : 0.0f;
+	return amplitude;
+}
+
+float
+OceanHeight(float x, float z, float t, float tidal_time)
+{
+	float height, nx, ny, nz;
+	evaluate_block(&x, &z, &height, &nx, &ny, &nz, 1, t, tidal_time);
+	return height;
+}
+
+glm::vec3
+OceanNormal(float x, float z, float t, float tidal_time)
+{
+	float height;
+	glm::vec3 normal;
+	evaluate_block(&x, &z, &height, &normal.x, &normal.y, &normal.z, 1, t, tidal_time);
+	return normal;
+}
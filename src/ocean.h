@@ -0,0 +1,70 @@
+#ifndef OCEAN_H
+#define OCEAN_H
+
+#include <glm/glm.hpp>
+#include <stddef.h>
+#include <vector>
+
+/*
+ * CPU version of the ocean surface drawn by ocean_geometry_shader: a sum of
+ * sinusoids plus the Gaussian tidal bump. The shader reads its waves from
+ * the same table through the uniforms in OCEAN_WAVE_UNIFORMS, so both sides
+ * always agree on the parameters. The FFT waves of OceanFFT are not
+ * covered.
+ */
+struct Wave {
+	glm::vec2 direction; // unit length
+	float frequency;
+	float speed;
+	float amplitude;
+};
+
+// A macro as well, so the GLSL declaration below can spell it out.
+#define OCEAN_NUM_WAVES 2
+const int kNumWaves = OCEAN_NUM_WAVES;
+extern const Wave kWaves[kNumWaves];
+
+const float kOceanLevel = -2.0f;
+const float kTidalWidth = 1.0f;
+const float kTidalHeight = 30.0f;
+
+// Structure of arrays, so the evaluation loops vectorise.
+struct OceanPoints {
+	std::vector<float> x;
+	std::vector<float> z;
+	std::vector<float> height;
+	std::vector<float> normal_x;
+	std::vector<float> normal_y;
+	std::vector<float> normal_z;
+	void resize(size_t size);
+	size_t size() const;
+};
+
+/*
+ * Fills in height and normal for every (x, z) of points at time t.
+ * tidal_time is the time since the tidal wave started, t - tidal_start_time
+ * in the shader. Large batches are split over OpenMP threads.
+ */
+void EvaluateOcean(OceanPoints* points, float t, float tidal_time);
+
+// Single point convenience versions of EvaluateOcean.
+float OceanHeight(float x, float z, float t, float tidal_time);
+glm::vec3 OceanNormal(float x, float z, float t, float tidal_time);
+
+// Largest distance of the surface from kOceanLevel, e.g. for culling.
+float OceanAmplitude(bool with_waves = true);
+
+#define OCEAN_STRINGIZE_(x) #x
+#define OCEAN_STRINGIZE(x) OCEAN_STRINGIZE_(x)
+
+// GLSL declaration of the wave table, see SetOceanUniforms in main.cc.
+#define OCEAN_WAVE_UNIFORMS \
+"const int num_waves = " OCEAN_STRINGIZE(OCEAN_NUM_WAVES) ";\n" \
+"uniform vec2 wave_direction[num_waves];\n" \
+"uniform float wave_frequency[num_waves];\n" \
+"uniform float wave_speed[num_waves];\n" \
+"uniform float wave_amplitude[num_waves];\n" \
+"uniform float tidal_width;\n" \
+"uniform float tidal_height;\n"
+
+#endif
@@ -0,0 +1,82 @@
+#include "ocean_clipmap.h"
+#include <cmath>
+
+#include "ocean.h"
+
+namespace {
+	const int kGridPatches = 8;
+
+	glm::uvec4 grid_patch(int i, int k)
+	{
+		const int row = kGridPatches + 1;
+		// Same corner order as the old fixed grid, see ocean_tesseval_shader.
+		return glm::uvec4(i * row + k, i * row + k + 1,
+		                  (i + 1) * row + k + 1, (i + 1) * row + k);
+	}
+};
+
+OceanClipmap::OceanClipmap(int rings, float patch_size)
+	: rings_(rings), patch_size_(patch_size)
+{
+	for (int i = 0; i <= kGridPatches; ++i)
+		for (int k = 0; k <= kGridPatches; ++k)
+			vertices_.push_back(glm::vec4(i - kGridPatches / 2, kOceanLevel,
+			                              k - kGridPatches / 2, 1.0f));
+
+	full_ = patches_.size();
+	for (int i = 0; i < kGridPatches; ++i)
+		for (int k = 0; k < kGridPatches; ++k)
+			patches_.push_back(grid_patch(i, k));
+
+	for (int dx = -1; dx <= 1; ++dx) {
+		for (int dz = -1; dz <= 1; ++dz) {
+			holes_[dx + 1][dz + 1] = patches_.size();
+			for (int i = 0; i < kGridPatches; ++i) {
+				for (int k = 0; k < kGridPatches; ++k) {
+					if (i >= 2 + dx && i < 6 + dx && k >= 2 + dz && k < 6 + dz)
+						continue;
+					patches_.push_back(grid_patch(i, k));
+				}
+			}
+		}
+	}
+}
+
+const std::vector<glm::vec4>&
+OceanClipmap::vertices() const
+{
+	return vertices_;
+}
+
+const std::vector<glm::uvec4>&
+OceanClipmap::patches() const
+{
+	return patches_;
+}
+
+void
+OceanClipmap::place(const glm::vec3& eye, std::vector<Ring>* rings) const
+{
+	rings->resize(rings_);
+	glm::vec2 inner_origin;
+	for (int r = 0; r < rings_; ++r) {
+		Ring& ring = (*rings)[r];
+		float size = std::ldexp(patch_size_, r);
+		glm::vec2 origin = glm::vec2(
+				std::floor(eye.x / (2.0f * size) + 0.5f),
+				std::floor(eye.z / (2.0f * size) + 0.5f)) * (2.0f * size);
+		ring.ring = glm::vec4(origin, size, r + 1 < rings_ ? 1.0f : 0.0f);
+		if (r == 0) {
+			ring.inner = glm::vec3(0.0f);
+			ring.first = full_ * 4;
+			ring.count = kGridPatches * kGridPatches * 4;
+		} else {
+			// The ring inside is at most one of our patches off centre.
+			glm::vec2 offset = glm::floor((inner_origin - origin) / size + 0.5f);
+			ring.inner = glm::vec3(inner_origin, 1.0f);
+			ring.first = holes_[int(offset.x) + 1][int(offset.y) + 1] * 4;
+			ring.count = (kGridPatches * kGridPatches - 16) * 4;
+		}
+		inner_origin = origin;
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef OCEAN_CLIPMAP_H
+#define OCEAN_CLIPMAP_H
+
+#include <glm/glm.hpp>
+#include <stddef.h>
+#include <vector>
+
+/*
+ * Ocean patches as nested square rings around the eye, a geometry clipmap.
+ *
+ * Every ring is 8x8 patches of one shared 9x9 vertex grid, in grid units
+ * that the vertex shader scales by the ring's patch size and offsets by its
+ * origin. Ring 0 is complete, and every further ring doubles the patch size
+ * and leaves out the 4x4 patches the previous ring covers. The cost is 64 +
+ * 48 * (rings - 1) patches whatever the distance to the horizon.
+ *
+ * Ring origins snap to twice their patch size, so the surface does not
+ * swim as the eye moves. The hole of a ring then sits one patch off centre
+ * or not at all in each direction, and the index buffer holds all nine
+ * variants.
+ */
+class OceanClipmap {
+public:
+	struct Ring {
+		glm::vec4 ring;       // origin x, origin z, patch size, 1 if a coarser ring follows
+		glm::vec3 inner;      // origin x, origin z of the ring inside, 1 if there is one
+		size_t first;         // first index of its patches
+		size_t count;         // number of indices
+	};
+	OceanClipmap(int rings = 8, float patch_size = 1.0f);
+	// Grid vertices and the patches of every variant, as GL_PATCHES of 4.
+	const std::vector<glm::vec4>& vertices() const;
+	const std::vector<glm::uvec4>& patches() const;
+	// Centres the rings on eye.
+	void place(const glm::vec3& eye, std::vector<Ring>* rings) const;
+private:
+	int rings_;
+	float patch_size_;
+	std::vector<glm::vec4> vertices_;
+	std::vector<glm::uvec4> patches_;
+	// Index of the first patch of the full grid and of each hole variant.
+	size_t full_;
+	size_t holes_[3][3];
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include "ocean_fft.h"
+#include <debuggl.h>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+namespace {
+	const float kGravity = 9.81f;
+	const float kPi = 3.14159265358979f;
+
+	// In-place unnormalized inverse DFT of n = 2^k elements spaced stride
+	// apart, i.e. x[m] = sum_j x[j] e^(2 pi i j m / n).
+	void inverse_fft(std::complex<float>* x, int n, int stride)
+	{
+		for (int i = 1, j = 0; i < n; ++i) {
+			int bit = n >> 1;
+			for (; j & bit; bit >>= 1)
+				j ^= bit;
+			j ^= bit;
+			if (i < j)
+				std::swap(x[i * stride], x[j * stride]);
+		}
+		for (int length = 2; length <= n; length <<= 1) {
+			float angle = 2.0f * kPi / length;
+			std::complex<float> step(std::cos(angle), std::sin(angle));
+			for (int i = 0; i < n; i += length) {
+				std::complex<float> w(1.0f, 0.0f);
+				for (int j = 0; j < length / 2; ++j) {
+					std::complex<float>& a = x[(i + j) * stride];
+					std::complex<float>& b = x[(i + j + length / 2) * stride];
+					std::complex<float> t = w * b;
+					b = a - t;
+					a += t;
+					w *= step;
+				}
+			}
+		}
+	}
+
+	// Phillips spectrum, with the waves much shorter than damping
+	// suppressed.
+	float phillips(const glm::vec2& k, const glm::vec2& wind)
+	{
+		float k2 = glm::dot(k, k);
+		if (k2 < 1e-8f)
+			return 0.0f;
+		float speed = glm::length(wind);
+		float largest = speed * speed / kGravity;
+		float damping = largest * 0.001f;
+		float alignment = glm::dot(k / std::sqrt(k2), wind / speed);
+		return std::exp(-1.0f / (k2 * largest * largest)) / (k2 * k2) *
+		       alignment * alignment * std::exp(-k2 * damping * damping);
+	}
+};
+
+OceanFFT::OceanFFT(int resolution, float patch_size, const glm::vec2& wind,
+                   float wave_height, float choppiness)
+	: resolution_(resolution), patch_size_(patch_size),
+	  wave_height_(wave_height), choppiness_(choppiness)
+{
+	const int n = resolution_;
+	h0_.resize(n * n);
+	h0_conj_minus_k_.resize(n * n);
+	omega_.resize(n * n);
+	for (auto& spectrum : spectrum_)
+		spectrum.resize(n * n);
+	displacement_.resize(n * n);
+	normal_.resize(n * n);
+
+	// Fixed seed, so every run shows the same sea.
+	std::mt19937 rng(1337);
+	std::normal_distribution<float> gaussian;
+	double energy = 0.0;
+	for (int z = 0; z < n; ++z) {
+		for (int x = 0; x < n; ++x) {
+			glm::vec2 k = 2.0f * kPi / patch_size_ * glm::vec2(x - n / 2, z - n / 2);
+			float amplitude = std::sqrt(0.5f * phillips(k, wind));
+			Complex h0(gaussian(rng) * amplitude, gaussian(rng) * amplitude);
+			h0_[z * n + x] = h0;
+			omega_[z * n + x] = std::sqrt(kGravity * glm::length(k));
+			energy += std::norm(h0);
+		}
+	}
+	// The mean square height is the total energy of h0(k) and h0(-k), see
+	// Parseval's theorem. Scale it to the requested height.
+	float scale = energy > 0.0 ? wave_height / std::sqrt(2.0 * energy) : 0.0f;
+	for (auto& h0 : h0_)
+		h0 *= scale;
+	for (int z = 0; z < n; ++z)
+		for (int x = 0; x < n; ++x)
+			h0_conj_minus_k_[z * n + x] =
+				std::conj(h0_[((n - z) % n) * n + (n - x) % n]);
+
+	CHECK_GL_ERROR(glGenTextures(2, textures_));
+	for (GLuint texture : textures_) {
+		CHECK_GL_ERROR(glBindTexture(GL_TEXTURE_2D, texture));
+		CHECK_GL_ERROR(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, n, n, 0,
+					GL_RGBA, GL_FLOAT, nullptr));
+		CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+		CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+		CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT));
+		CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT));
+	}
+}
+
+OceanFFT::~OceanFFT()
+{
+	glDeleteTextures(2, textures_);
+}
+
+void
+OceanFFT::update(float t)
+{
+	const int n = resolution_;
+	const Complex i(0.0f, 1.0f);
+
+	#pragma omp parallel for
+	for (int z = 0; z < n; ++z) {
+		for (int x = 0; x < n; ++x) {
+			int index = z * n + x;
+			glm::vec2 k = 2.0f * kPi / patch_size_ * glm::vec2(x - n / 2, z - n / 2);
+			float length = glm::length(k);
+			Complex phase = std::polar(1.0f, omega_[index] * t);
+			Complex h = h0_[index] * phase + h0_conj_minus_k_[index] * std::conj(phase);
+			Complex dx = 0.0f, dz = 0.0f;
+			if (length > 1e-6f) {
+				dx = -i * (choppiness_ * k.x / length) * h;
+				dz = -i * (choppiness_ * k.y / length) * h;
+			}
+			// Both fields of a pair are real, so one transform gives both.
+			spectrum_[0][index] = h + i * dx;
+			spectrum_[1][index] = dz + i * (i * k.x * h);
+			spectrum_[2][index] = i * k.y * h;
+		}
+	}
+	for (auto& spectrum : spectrum_)
+		inverse_fft_2d(spectrum);
+
+	#pragma omp parallel for
+	for (int z = 0; z < n; ++z) {
+		for (int x = 0; x < n; ++x) {
+			int index = z * n + x;
+			// Undo the shift of k by n / 2 in both directions.
+			float sign = ((x + z) & 1) ? -1.0f : 1.0f;
+			Complex a = sign * spectrum_[0][index];
+			Complex b = sign * spectrum_[1][index];
+			float slope_z = sign * spectrum_[2][index].real();
+			displacement_[index] = glm::vec4(a.imag(), a.real(), b.real(), 0.0f);
+			normal_[index] = glm::vec4(glm::normalize(
+					glm::vec3(-b.imag(), 1.0f, -slope_z)), 0.0f);
+		}
+	}
+
+	CHECK_GL_ERROR(glActiveTexture(GL_TEXTURE0 + kOceanDisplacementUnit));
+	CHECK_GL_ERROR(glBindTexture(GL_TEXTURE_2D, textures_[0]));
+	CHECK_GL_ERROR(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, n, n, GL_RGBA,
+				GL_FLOAT, displacement_.data()));
+	CHECK_GL_ERROR(glActiveTexture(GL_TEXTURE0 + kOceanNormalUnit));
+	CHECK_GL_ERROR(glBindTexture(GL_TEXTURE_2D, textures_[1]));
+	CHECK_GL_ERROR(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, n, n, GL_RGBA,
+				GL_FLOAT, normal_.data()));
+	CHECK_GL_ERROR(glActiveTexture(GL_TEXTURE0));
+}
+
+// Rows, then columns, one line per thread.
+void
+OceanFFT::inverse_fft_2d(std::vector<Complex>& data)
+{
+	const int n = resolution_;
+	#pragma omp parallel for
+	for (int z = 0; z < n; ++z)
+		inverse_fft(&data[z * n], n, 1);
+	#pragma omp parallel for
+	for (int x = 0; x < n; ++x)
+		inverse_fft(&data[x], n, n);
+}
+
+float
+OceanFFT::patch_size() const
+{
+	return patch_size_;
+}
+
+glm::vec2
+OceanFFT::displacement_bound() const
+{
+	return 4.0f * wave_height_ * glm::vec2(choppiness_, 1.0f);
+}
+
+GLuint
+OceanFFT::displacement_texture() const
+{
+	return textures_[0];
+}
+
+GLuint
+OceanFFT::normal_texture() const
+{
+	return textures_[1];
+}
@@ -0,0 +1,58 @@
+#ifndef OCEAN_FFT_H
+#define OCEAN_FFT_H
+
+#include <GL/glew.h>
+#include <complex>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Texture units the ocean textures stay bound to.
+const int kOceanDisplacementUnit = 2;
+const int kOceanNormalUnit = 3;
+
+/*
+ * Statistical ocean after Tessendorf, "Simulating Ocean Water".
+ *
+ * A Phillips spectrum of resolution x resolution waves is sampled once.
+ * update() evolves it to time t and inverse-FFTs it on the CPU, spread
+ * over OpenMP threads, into two RGBA32F textures that tile every
+ * patch_size world units:
+ *   displacement: (x, y, z) offset of the surface point
+ *   normal:       unit surface normal
+ * The cost only depends on the resolution, not on how many waves there are.
+ * update() leaves the textures bound to kOceanDisplacementUnit and
+ * kOceanNormalUnit, and texture unit 0 active.
+ */
+class OceanFFT {
+public:
+	// wind is in world units per second, and wave_height is the RMS height.
+	OceanFFT(int resolution = 128, float patch_size = 20.0f,
+	         const glm::vec2& wind = glm::vec2(6.0f, 3.0f),
+	         float wave_height = 0.25f, float choppiness = 1.0f);
+	~OceanFFT();
+	void update(float t);
+	float patch_size() const;
+	// Practical bound on the (horizontal, vertical) displacement, four
+	// standard deviations.
+	glm::vec2 displacement_bound() const;
+	GLuint displacement_texture() const;
+	GLuint normal_texture() const;
+private:
+	typedef std::complex<float> Complex;
+	void inverse_fft_2d(std::vector<Complex>& data);
+
+	int resolution_;
+	float patch_size_;
+	float wave_height_;
+	float choppiness_;
+	std::vector<Complex> h0_;
+	std::vector<Complex> h0_conj_minus_k_;
+	std::vector<float> omega_;
+	// Spectra of (height + i dx), (dz + i slope_x) and slope_z.
+	std::vector<Complex> spectrum_[3];
+	std::vector<glm::vec4> displacement_;
+	std::vector<glm::vec4> normal_;
+	GLuint textures_[2];
+};
+
+#endif
@@ -0,0 +1,152 @@
+#include "program_cache.h"
+#include <debuggl.h>
+#include <fstream>
+#include <iostream>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+namespace {
+	const uint32_t kMagic = 0x4250474d; // "MGPB"
+
+	void hash_bytes(uint64_t& hash, const void* data, size_t size)
+	{
+		// FNV-1a
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; ++i) {
+			hash ^= bytes[i];
+			hash *= 1099511628211ULL;
+		}
+	}
+
+	void hash_string(uint64_t& hash, const std::string& s)
+	{
+		// Include the terminator so that ("ab", "c") != ("a", "bc").
+		hash_bytes(hash, s.c_str(), s.size() + 1);
+	}
+
+	std::string gl_string(GLenum name)
+	{
+		const GLubyte* s = glGetString(name);
+		return s ? reinterpret_cast<const char*>(s) : "";
+	}
+};
+
+ProgramCache::ProgramCache(const std::string& directory)
+	: directory_(directory)
+{
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	if (formats == 0) {
+		directory_.clear();
+		return;
+	}
+	if (!directory_.empty())
+		mkdir(directory_.c_str(), 0755);
+	driver_ = gl_string(GL_VENDOR) + "\n" + gl_string(GL_RENDERER) + "\n" +
+	          gl_string(GL_VERSION);
+}
+
+ProgramCache::~ProgramCache()
+{
+	for (auto& shader : shaders_)
+		glDeleteShader(shader.second);
+}
+
+GLuint
+ProgramCache::build(const std::string& name,
+                    const std::vector<ShaderSource>& shaders,
+                    const std::vector<const char*>& attributes)
+{
+	GLuint program_id = 0;
+	CHECK_GL_ERROR(program_id = glCreateProgram());
+
+	std::string file;
+	if (!directory_.empty()) {
+		uint64_t hash = 14695981039346656037ULL;
+		hash_string(hash, driver_);
+		for (const auto& shader : shaders) {
+			hash_bytes(hash, &shader.type, sizeof(shader.type));
+			hash_string(hash, shader.source);
+		}
+		for (const char* attribute : attributes)
+			hash_string(hash, attribute);
+		char hex[17];
+		snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+		file = directory_ + "/" + name + "-" + hex + ".bin";
+		if (load(file, program_id))
+			return program_id;
+	}
+
+	for (const auto& shader : shaders)
+		CHECK_GL_ERROR(glAttachShader(program_id, compile(shader)));
+	for (size_t i = 0; i < attributes.size(); ++i)
+		CHECK_GL_ERROR(glBindAttribLocation(program_id, i, attributes[i]));
+	CHECK_GL_ERROR(glBindFragDataLocation(program_id, 0, "fragment_color"));
+	if (!file.empty())
+		CHECK_GL_ERROR(glProgramParameteri(program_id,
+					GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+	glLinkProgram(program_id);
+	CHECK_GL_PROGRAM_ERROR(program_id);
+
+	if (!file.empty())
+		store(file, program_id);
+	return program_id;
+}
+
+// Shader objects are shared between programs, e.g. the vertex shader.
+GLuint
+ProgramCache::compile(const ShaderSource& shader)
+{
+	auto key = std::make_pair(shader.type, std::string(shader.source));
+	auto it = shaders_.find(key);
+	if (it != shaders_.end())
+		return it->second;
+
+	GLuint shader_id = 0;
+	CHECK_GL_ERROR(shader_id = glCreateShader(shader.type));
+	CHECK_GL_ERROR(glShaderSource(shader_id, 1, &shader.source, nullptr));
+	glCompileShader(shader_id);
+	CHECK_GL_SHADER_ERROR(shader_id);
+	shaders_[key] = shader_id;
+	return shader_id;
+}
+
+bool
+ProgramCache::load(const std::string& file, GLuint program) const
+{
+	std::ifstream in(file, std::ios::binary);
+	uint32_t header[3];
+	if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+	    header[0] != kMagic)
+		return false;
+	std::vector<char> binary(header[2]);
+	if (!in.read(binary.data(), binary.size()))
+		return false;
+
+	glProgramBinary(program, header[1], binary.data(), binary.size());
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	// A rejected binary is not an error, we just compile instead.
+	glGetError();
+	return status == GL_TRUE;
+}
+
+void
+ProgramCache::store(const std::string& file, GLuint program) const
+{
+	GLint length = 0;
+	CHECK_GL_ERROR(glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length));
+	if (length <= 0)
+		return;
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	CHECK_GL_ERROR(glGetProgramBinary(program, length, nullptr, &format, binary.data()));
+
+	std::ofstream out(file, std::ios::binary);
+	uint32_t header[3] = { kMagic, format, uint32_t(length) };
+	out.write(reinterpret_cast<const char*>(header), sizeof(header));
+	out.write(binary.data(), binary.size());
+	if (!out)
+		std::cerr << "Failed to write program binary " << file << "\n";
+}
@@ -0,0 +1,45 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <GL/glew.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct ShaderSource {
+	GLenum type;
+	const char* source;
+};
+
+/*
+ * Builds GLSL programs, saving the linked binaries with glGetProgramBinary
+ * and loading them back with glProgramBinary on later runs.
+ *
+ * Entries are keyed by a hash of the sources, the attribute bindings and
+ * the driver's vendor, renderer and version strings, so editing a shader or
+ * updating the driver never loads a stale binary. A binary the driver
+ * rejects anyway is replaced by compiling from source.
+ */
+class ProgramCache {
+public:
+	// An empty directory disables the on-disk cache.
+	explicit ProgramCache(const std::string& directory);
+	~ProgramCache();
+	// attributes[i] is bound to location i, and fragment_color to output 0.
+	GLuint build(const std::string& name,
+	             const std::vector<ShaderSource>& shaders,
+	             const std::vector<const char*>& attributes = { "vertex_position" });
+private:
+	GLuint compile(const ShaderSource& shader);
+	bool load(const std::string& file, GLuint program) const;
+	void store(const std::string& file, GLuint program) const;
+
+	std::string directory_;
+	std::string driver_;
+	// Compiled shaders by type and source text, not by the source's
+	// address, which a freed string can hand on to another source.
+	std::map<std::pair<GLenum, std::string>, GLuint> shaders_;
+};
+
+#endif
@@ -0,0 +1,205 @@
+#include "raytracer.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdint.h>
+
+namespace {
+	const int kTileSize = 32;
+	// The floor of CreateFloor, and the shadow term of its shader.
+	const float kFloorHeight = -3.0f;
+	const float kFloorExtent = 10.0f;
+	const float kShadowFactor = 0.4f;
+	const float kInfinity = std::numeric_limits<float>::infinity();
+
+	// The 7 removed sub-cubes have at least two middle coordinates.
+	bool kept(const glm::ivec3& cell)
+	{
+		return (cell.x == 1) + (cell.y == 1) + (cell.z == 1) < 2;
+	}
+
+	// Jitter that depends only on the pixel, not on which thread draws it.
+	float next_random(uint32_t* state)
+	{
+		uint32_t x = *state;
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		*state = x;
+		return (x >> 8) * (1.0f / 16777216.0f);
+	}
+
+	int sample_grid(int samples)
+	{
+		return std::max(1, int(std::sqrt(float(samples)) + 0.5f));
+	}
+
+	unsigned char to_byte(float value)
+	{
+		return static_cast<unsigned char>(
+				std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+};
+
+RayTracer::RayTracer(int nesting_level, const glm::vec4& light_position)
+	: nesting_level_(nesting_level), light_position_(light_position)
+{
+}
+
+void
+RayTracer::render(const glm::mat4& view, float fovy, int width, int height,
+                  int samples, std::vector<unsigned char>* pixels) const
+{
+	pixels->assign(size_t(width) * height * 3, 0);
+	glm::mat4 inverse_view = glm::inverse(view);
+	glm::vec3 eye(inverse_view[3]);
+	float tan_half = std::tan(0.5f * fovy);
+	float aspect = float(width) / height;
+	// Samples are stratified over a grid x grid pattern.
+	int grid = sample_grid(samples);
+	float weight = 1.0f / (grid * grid);
+
+	int tiles_x = (width + kTileSize - 1) / kTileSize;
+	int tiles_y = (height + kTileSize - 1) / kTileSize;
+	int tiles = tiles_x * tiles_y;
+	#pragma omp parallel for schedule(dynamic, 1)
+	for (int tile = 0; tile < tiles; ++tile) {
+		int x0 = (tile % tiles_x) * kTileSize;
+		int y0 = (tile / tiles_x) * kTileSize;
+		int x1 = std::min(x0 + kTileSize, width);
+		int y1 = std::min(y0 + kTileSize, height);
+		for (int y = y0; y < y1; ++y) {
+			for (int x = x0; x < x1; ++x) {
+				uint32_t state = uint32_t(y * width + x) * 2654435761u + 1u;
+				glm::vec3 color(0.0f);
+				for (int sy = 0; sy < grid; ++sy) {
+					for (int sx = 0; sx < grid; ++sx) {
+						float jx = grid > 1 ? next_random(&state) : 0.5f;
+						float jy = grid > 1 ? next_random(&state) : 0.5f;
+						float u = (x + (sx + jx) / grid) / width * 2.0f - 1.0f;
+						float v = (y + (sy + jy) / grid) / height * 2.0f - 1.0f;
+						glm::vec4 direction(u * tan_half * aspect, v * tan_half,
+						                    -1.0f, 0.0f);
+						color += trace(eye, glm::normalize(
+								glm::vec3(inverse_view * direction)));
+					}
+				}
+				color *= weight;
+				unsigned char* pixel = &(*pixels)[(size_t(y) * width + x) * 3];
+				pixel[0] = to_byte(color[0]);
+				pixel[1] = to_byte(color[1]);
+				pixel[2] = to_byte(color[2]);
+			}
+		}
+	}
+}
+
+int
+RayTracer::rounded_samples(int samples)
+{
+	int grid = sample_grid(samples);
+	return grid * grid;
+}
+
+glm::vec3
+RayTracer::trace(const glm::vec3& origin, const glm::vec3& direction) const
+{
+	float t_sponge = kInfinity;
+	glm::vec3 normal;
+	intersect_sponge(origin, direction, kInfinity, &t_sponge, &normal);
+
+	// The floor is only seen from above, as it is culled otherwise.
+	float t_floor = kInfinity;
+	if (origin.y > kFloorHeight && direction.y < 0.0f) {
+		float t = (kFloorHeight - origin.y) / direction.y;
+		glm::vec3 p = origin + t * direction;
+		if (std::abs(p.x) <= kFloorExtent && std::abs(p.z) <= kFloorExtent)
+			t_floor = t;
+	}
+
+	if (t_sponge < t_floor) {
+		glm::vec3 p = origin + t_sponge * direction;
+		float dot_nl = glm::dot(glm::normalize(light_position_ - p), normal);
+		return glm::abs(normal) * glm::clamp(dot_nl, 0.0f, 1.0f);
+	}
+	if (t_floor < kInfinity) {
+		glm::vec3 p = origin + t_floor * direction;
+		int checker = (int(std::floor(p.x)) + int(std::floor(p.z))) & 1;
+		glm::vec3 to_light = light_position_ - p;
+		float dot_nl = glm::clamp(glm::normalize(to_light).y, 0.0f, 1.0f);
+		float t = 0.0f;
+		glm::vec3 unused;
+		if (intersect_sponge(p, to_light, 1.0f, &t, &unused))
+			dot_nl *= kShadowFactor;
+		return glm::vec3(checker * dot_nl);
+	}
+	return glm::vec3(0.0f);
+}
+
+bool
+RayTracer::intersect_sponge(const glm::vec3& origin, const glm::vec3& direction,
+                            float max_t, float* t, glm::vec3* normal) const
+{
+	glm::vec3 inverse_direction = glm::vec3(1.0f) / direction;
+	return intersect_cube(origin, inverse_direction, glm::vec3(-0.5f), 1.0f,
+	                      nesting_level_, max_t, t, normal);
+}
+
+// Slab test of the cube, then a 3D DDA through its kept sub-cubes.
+bool
+RayTracer::intersect_cube(const glm::vec3& origin, const glm::vec3& inverse_direction,
+                          const glm::vec3& min, float size, int level,
+                          float max_t, float* t, glm::vec3* normal) const
+{
+	glm::vec3 t0 = (min - origin) * inverse_direction;
+	glm::vec3 t1 = (min + size - origin) * inverse_direction;
+	glm::vec3 t_near = glm::min(t0, t1);
+	glm::vec3 t_far = glm::max(t0, t1);
+	float enter = std::max(std::max(t_near.x, t_near.y), t_near.z);
+	float exit = std::min(std::min(std::min(t_far.x, t_far.y), t_far.z), max_t);
+	if (!(enter <= exit) || exit < 0.0f)
+		return false;
+
+	if (level == 0) {
+		int axis = t_near.x == enter ? 0 : (t_near.y == enter ? 1 : 2);
+		*normal = glm::vec3(0.0f);
+		(*normal)[axis] = inverse_direction[axis] > 0.0f ? -1.0f : 1.0f;
+		*t = std::max(enter, 0.0f);
+		return true;
+	}
+
+	float child = size / 3.0f;
+	glm::vec3 direction = glm::vec3(1.0f) / inverse_direction;
+	glm::vec3 start = origin + std::max(enter, 0.0f) * direction;
+	glm::ivec3 cell(glm::floor((start - min) / child));
+	glm::ivec3 step;
+	glm::vec3 next, delta;
+	for (int i = 0; i < 3; ++i) {
+		cell[i] = std::min(std::max(cell[i], 0), 2);
+		step[i] = direction[i] > 0.0f ? 1 : -1;
+		if (direction[i] == 0.0f) {
+			next[i] = kInfinity;
+			delta[i] = kInfinity;
+			continue;
+		}
+		float boundary = min[i] + (cell[i] + (step[i] > 0 ? 1 : 0)) * child;
+		next[i] = (boundary - origin[i]) * inverse_direction[i];
+		delta[i] = child * std::abs(inverse_direction[i]);
+	}
+
+	// Cells are visited front to back, so the first hit is the nearest.
+	for (;;) {
+		if (kept(cell) &&
+		    intersect_cube(origin, inverse_direction, min + child * glm::vec3(cell),
+		                   child, level - 1, max_t, t, normal))
+			return true;
+		int axis = next.x < next.y ? (next.x < next.z ? 0 : 2)
+		                           : (next.y < next.z ? 1 : 2);
+		if (next[axis] > exit)
+			return false;
+		cell[axis] += step[axis];
+		if (cell[axis] < 0 || cell[axis] > 2)
+			return false;
+		next[axis] += delta[axis];
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef RAYTRACER_H
+#define RAYTRACER_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+/*
+ * Offline CPU renderer of the sponge over the checkered floor, for stills
+ * larger or smoother than the raster path gives, on machines with no GPU.
+ *
+ * Rays walk the sponge's implicit hierarchy instead of its triangles: at
+ * every level they step through the 3x3x3 sub-cubes in the order they
+ * cross them, skipping the 7 removed ones, so the first leaf hit is the
+ * nearest and the cost grows with the level, not with the 20^level cubes.
+ *
+ * Shading follows the sponge and floor shaders, with a point light and a
+ * shadow ray for the floor. The image is split into tiles that the OpenMP
+ * threads take one at a time, so busy tiles never hold up idle threads.
+ */
+class RayTracer {
+public:
+	RayTracer(int nesting_level, const glm::vec4& light_position);
+	// Renders what a camera with this view matrix and vertical field of
+	// view (radians) sees, averaging samples jittered rays per pixel.
+	// pixels are GL_RGB rows stored bottom-up, ready for SaveJPEG.
+	void render(const glm::mat4& view, float fovy, int width, int height,
+	            int samples, std::vector<unsigned char>* pixels) const;
+	// Samples per pixel render takes when asked for samples: they are
+	// stratified over a square grid, so the nearest square, at least 1.
+	static int rounded_samples(int samples);
+	// Color of one ray, in [0, 1].
+	glm::vec3 trace(const glm::vec3& origin, const glm::vec3& direction) const;
+	// Distance along direction to the sponge, false if the ray misses it
+	// before max_t.
+	bool intersect_sponge(const glm::vec3& origin, const glm::vec3& direction,
+	                      float max_t, float* t, glm::vec3* normal) const;
+private:
+	bool intersect_cube(const glm::vec3& origin, const glm::vec3& inverse_direction,
+	                    const glm::vec3& min, float size, int level,
+	                    float max_t, float* t, glm::vec3* normal) const;
+
+	int nesting_level_;
+	glm::vec3 light_position_;
+};
+
+#endif
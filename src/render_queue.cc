@@ -0,0 +1,68 @@
+#include "render_queue.h"
+#include <algorithm>
+#include <debuggl.h>
+#include <iostream>
+
+#include "gpu_timer.h"
+
+void
+RenderQueue::add(const RenderPass& pass)
+{
+	passes_.push_back(pass);
+}
+
+void
+RenderQueue::execute(GpuTimer* timer)
+{
+	std::stable_sort(passes_.begin(), passes_.end(),
+		[](const RenderPass& a, const RenderPass& b) {
+			if (a.layer != b.layer)
+				return a.layer < b.layer;
+			if (a.state.program != b.state.program)
+				return a.state.program < b.state.program;
+			return a.state.vao < b.state.vao;
+		});
+	bool first = true;
+	for (const RenderPass& pass : passes_) {
+		if (timer && pass.timer_pass >= 0)
+			timer->begin(pass.timer_pass);
+		apply(pass.state, first);
+		first = false;
+		pass.draw();
+		if (timer && pass.timer_pass >= 0)
+			timer->end(pass.timer_pass);
+	}
+	passes_.clear();
+}
+
+void
+RenderQueue::apply(const RenderState& state, bool force)
+{
+	if (force || state.program != current_.program)
+		CHECK_GL_ERROR(glUseProgram(state.program));
+	// A pass without a VAO binds its own, and current_.vao becomes 0 below,
+	// so the next pass with a VAO always binds it.
+	if (state.vao != 0 && (force || state.vao != current_.vao))
+		CHECK_GL_ERROR(glBindVertexArray(state.vao));
+	if (force || state.polygon_mode != current_.polygon_mode)
+		CHECK_GL_ERROR(glPolygonMode(GL_FRONT_AND_BACK, state.polygon_mode));
+	if (force || state.cull_face != current_.cull_face) {
+		if (state.cull_face)
+			CHECK_GL_ERROR(glEnable(GL_CULL_FACE));
+		else
+			CHECK_GL_ERROR(glDisable(GL_CULL_FACE));
+	}
+	if (force || state.depth_write != current_.depth_write)
+		CHECK_GL_ERROR(glDepthMask(state.depth_write ? GL_TRUE : GL_FALSE));
+	if (force || state.depth_func != current_.depth_func)
+		CHECK_GL_ERROR(glDepthFunc(state.depth_func));
+	if (state.patch_vertices > 0 &&
+	    (force || state.patch_vertices != current_.patch_vertices))
+		CHECK_GL_ERROR(glPatchParameteri(GL_PATCH_VERTICES, state.patch_vertices));
+	// Passes without patches leave GL_PATCH_VERTICES as it was.
+	GLint patch_vertices = state.patch_vertices;
+	if (patch_vertices == 0 && !force)
+		patch_vertices = current_.patch_vertices;
+	current_ = state;
+	current_.patch_vertices = patch_vertices;
+}
@@ -0,0 +1,57 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <GL/glew.h>
+#include <functional>
+#include <vector>
+
+class GpuTimer;
+
+// Fixed-function state a pass draws with.
+struct RenderState {
+	GLuint program = 0;
+	// 0 for passes whose draw binds its own VAOs. The queue then binds
+	// none, and rebinds for the next pass that names one.
+	GLuint vao = 0;
+	GLenum polygon_mode = GL_FILL;
+	bool cull_face = true;
+	bool depth_write = true;
+	GLenum depth_func = GL_LESS;
+	// GL_PATCH_VERTICES, or 0 for passes that draw no patches.
+	GLint patch_vertices = 0;
+};
+
+struct RenderPass {
+	// Passes of a lower layer always draw first, e.g. the sky after
+	// everything opaque so only its visible pixels are shaded.
+	int layer = 0;
+	// GpuTimer pass, or -1.
+	int timer_pass = -1;
+	RenderState state;
+	// Sets the pass's own uniforms and issues its draws.
+	std::function<void()> draw;
+};
+
+/*
+ * One frame's worth of passes, drawn in an order that changes as little GL
+ * state as possible.
+ *
+ * Passes are sorted by layer, then program, then VAO, keeping the order
+ * they were added in otherwise. Only the state that differs from the
+ * previous pass is set. Disabled passes are never added, so they cost
+ * nothing instead of a draw of zero elements.
+ */
+class RenderQueue {
+public:
+	void add(const RenderPass& pass);
+	// Draws and removes every pass. Nothing is assumed about the GL state
+	// on entry, and the last pass's state is left behind.
+	void execute(GpuTimer* timer);
+private:
+	void apply(const RenderState& state, bool force);
+
+	std::vector<RenderPass> passes_;
+	RenderState current_;
+};
+
+#endif
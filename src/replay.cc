@@ -0,0 +1,67 @@
+#include "replay.h"
+#include <iostream>
+#include <sstream>
+
+namespace {
+	const char* kReplayHeader = "menger-replay 1";
+};
+
+ReplayWriter::ReplayWriter(const std::string& file)
+	: out_(file)
+{
+	if (!out_)
+		std::cerr << "Failed to open " << file << " for recording\n";
+	out_ << kReplayHeader << "\n";
+}
+
+bool
+ReplayWriter::is_open() const
+{
+	return bool(out_);
+}
+
+void
+ReplayWriter::write(const Camera& camera, const ReplayState& state)
+{
+	out_.precision(9);
+	out_ << state.nesting_level << ' ' << state.ocean_mode << ' '
+	     << state.wireframe << ' ' << state.faces << ' ' << state.skybox << ' '
+	     << state.reflective << ' ' << state.transparent << ' '
+	     << state.tess_level_inner << ' ' << state.tess_level_outer << ' '
+	     << state.tidal_start_time << ' ';
+	camera.save_state(out_);
+	out_ << "\n";
+}
+
+ReplayReader::ReplayReader(const std::string& file)
+	: in_(file)
+{
+	std::string header;
+	if (!std::getline(in_, header) || header != kReplayHeader) {
+		std::cerr << file << " is not a replay log\n";
+		in_.setstate(std::ios::failbit);
+	}
+}
+
+bool
+ReplayReader::is_open() const
+{
+	return bool(in_);
+}
+
+bool
+ReplayReader::read(Camera* camera, ReplayState* state)
+{
+	std::string line;
+	if (!std::getline(in_, line))
+		return false;
+	std::istringstream fields(line);
+	ReplayState s;
+	fields >> s.nesting_level >> s.ocean_mode >> s.wireframe >> s.faces
+	       >> s.skybox >> s.reflective >> s.transparent
+	       >> s.tess_level_inner >> s.tess_level_outer >> s.tidal_start_time;
+	if (!fields || !camera->load_state(fields))
+		return false;
+	*state = s;
+	return true;
+}
@@ -0,0 +1,50 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <fstream>
+#include <string>
+
+#include "camera.h"
+
+// Render settings the keyboard can change, besides the camera.
+struct ReplayState {
+	int nesting_level = 0;
+	bool ocean_mode = false;
+	bool wireframe = false;
+	bool faces = false;
+	bool skybox = false;
+	bool reflective = false;
+	bool transparent = false;
+	float tess_level_inner = 0.0f;
+	float tess_level_outer = 0.0f;
+	float tidal_start_time = 0.0f;
+};
+
+/*
+ * Session log with one line per frame, holding the camera and the
+ * ReplayState that frame was drawn with. Logging state instead of input
+ * events keeps replays exact even when key repeat or mouse deltas arrive
+ * differently. Played back on a fixed clock, the log reproduces the session
+ * frame for frame, ocean animation included, so two builds can be compared
+ * on the same camera path.
+ */
+class ReplayWriter {
+public:
+	explicit ReplayWriter(const std::string& file);
+	bool is_open() const;
+	void write(const Camera& camera, const ReplayState& state);
+private:
+	std::ofstream out_;
+};
+
+class ReplayReader {
+public:
+	explicit ReplayReader(const std::string& file);
+	bool is_open() const;
+	// False at the end of the log or on a malformed line.
+	bool read(Camera* camera, ReplayState* state);
+private:
+	std::ifstream in_;
+};
+
+#endif
@@ -0,0 +1,111 @@
+#include "shadow_map.h"
+#include <debuggl.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <glm/gtc/matrix_transform.hpp>
+
+ShadowMap::ShadowMap(const glm::vec3& center, float radius, int size)
+	: center_(center), radius_(radius), size_(size)
+{
+	CHECK_GL_ERROR(glGenTextures(1, &texture_));
+	CHECK_GL_ERROR(glBindTexture(GL_TEXTURE_2D, texture_));
+	CHECK_GL_ERROR(glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24,
+				size_, size_, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr));
+	// Linear filtering of a comparison texture gives 2x2 PCF.
+	CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+	CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+	CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE,
+				GL_COMPARE_REF_TO_TEXTURE));
+	CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL));
+	// Everything outside the light's frustum is lit.
+	const float border[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER));
+	CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER));
+	CHECK_GL_ERROR(glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border));
+
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_framebuffer_);
+	CHECK_GL_ERROR(glGenFramebuffers(1, &framebuffer_));
+	CHECK_GL_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_));
+	CHECK_GL_ERROR(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+				GL_TEXTURE_2D, texture_, 0));
+	CHECK_GL_ERROR(glDrawBuffer(GL_NONE));
+	CHECK_GL_ERROR(glReadBuffer(GL_NONE));
+	GLenum status = GL_FRAMEBUFFER_COMPLETE;
+	CHECK_GL_ERROR(status = glCheckFramebufferStatus(GL_FRAMEBUFFER));
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+		std::cerr << "Shadow map framebuffer incomplete: " << status << "\n";
+	CHECK_GL_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, previous_framebuffer_));
+}
+
+ShadowMap::~ShadowMap()
+{
+	glDeleteFramebuffers(1, &framebuffer_);
+	glDeleteTextures(1, &texture_);
+}
+
+void
+ShadowMap::set_light(const glm::vec4& light_position)
+{
+	if (!dirty_ && light_position == light_position_)
+		return;
+	light_position_ = light_position;
+	dirty_ = true;
+
+	// Fit the frustum tightly around the bounding sphere, so the casters
+	// cover as many texels as possible.
+	glm::vec3 eye = glm::vec3(light_position);
+	float distance = std::max(glm::length(center_ - eye), radius_ * 1.01f);
+	float fov = 2.0f * std::asin(radius_ / distance);
+	glm::vec3 up = std::abs(glm::normalize(center_ - eye).y) > 0.99f ?
+	               glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::mat4 view = glm::lookAt(eye, center_, up);
+	// Receivers behind the far plane clamp to it and still compare as
+	// shadowed, so the frustum only has to enclose the casters.
+	glm::mat4 projection = glm::perspective(fov, 1.0f,
+			distance - radius_, distance + radius_);
+	light_view_projection_ = projection * view;
+}
+
+void
+ShadowMap::invalidate()
+{
+	dirty_ = true;
+}
+
+bool
+ShadowMap::is_dirty() const
+{
+	return dirty_;
+}
+
+const glm::mat4&
+ShadowMap::light_view_projection() const
+{
+	return light_view_projection_;
+}
+
+GLuint
+ShadowMap::texture() const
+{
+	return texture_;
+}
+
+void
+ShadowMap::begin()
+{
+	glGetIntegerv(GL_VIEWPORT, viewport_);
+	// Not always 0, e.g. the offscreen target of HeadlessContext.
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_framebuffer_);
+	CHECK_GL_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_));
+	CHECK_GL_ERROR(glViewport(0, 0, size_, size_));
+	CHECK_GL_ERROR(glClear(GL_DEPTH_BUFFER_BIT));
+}
+
+void
+ShadowMap::end()
+{
+	CHECK_GL_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, previous_framebuffer_));
+	CHECK_GL_ERROR(glViewport(viewport_[0], viewport_[1], viewport_[2], viewport_[3]));
+	dirty_ = false;
+}
@@ -0,0 +1,56 @@
+#ifndef SHADOW_MAP_H
+#define SHADOW_MAP_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Texture unit the shadow map stays bound to.
+const int kShadowMapUnit = 1;
+
+/*
+ * Depth texture of the shadow casters seen from a point light, aimed at a
+ * bounding sphere of the casters.
+ *
+ * The map is only re-rendered when it is dirty, i.e. when the light moved
+ * or invalidate() was called because the casters changed. Otherwise the
+ * last one is reused, and a shadow costs one comparison lookup in the
+ * receiving shaders, see SHADOW_MAP_LOOKUP.
+ */
+class ShadowMap {
+public:
+	ShadowMap(const glm::vec3& center, float radius, int size = 2048);
+	~ShadowMap();
+	void set_light(const glm::vec4& light_position);
+	void invalidate();
+	bool is_dirty() const;
+	// Draw the casters between begin() and end().
+	void begin();
+	void end();
+	const glm::mat4& light_view_projection() const;
+	GLuint texture() const;
+private:
+	glm::vec3 center_;
+	float radius_;
+	int size_;
+	GLuint texture_ = 0;
+	GLuint framebuffer_ = 0;
+	GLint viewport_[4];
+	GLint previous_framebuffer_ = 0;
+	glm::vec4 light_position_ = glm::vec4(0.0f);
+	glm::mat4 light_view_projection_;
+	bool dirty_ = true;
+};
+
+// GLSL shadow test, spliced into fragment shaders after FRAME_UNIFORM_BLOCK.
+// Returns 0 in shadow and 1 in light, filtered over 2x2 texels.
+#define SHADOW_MAP_LOOKUP \
+"uniform sampler2DShadow shadow_map;\n" \
+"float shadow(vec4 world_position)\n" \
+"{\n" \
+"	vec4 p = light_view_projection * world_position;\n" \
+"	if (p.w <= 0.0)\n" \
+"		return 1.0;\n" \
+"	return texture(shadow_map, p.xyz / p.w * 0.5 + 0.5);\n" \
+"}\n"
+
+#endif
@@ -0,0 +1,130 @@
+#include "sponge_field.h"
+#include <debuggl.h>
+#include <iostream>
+
+#include "menger.h"
+
+SpongeField::SpongeField()
+{
+}
+
+SpongeField::~SpongeField()
+{
+	for (auto& it : groups_) {
+		glDeleteBuffers(4, it.second.buffers);
+		glDeleteVertexArrays(1, &it.second.vao);
+	}
+}
+
+void
+SpongeField::add(const glm::mat4& transform, int level)
+{
+	Group& group = groups_[level];
+	group.transforms.push_back(transform);
+	group.dirty = true;
+}
+
+// The meshes are kept, so refilling the field builds no new ones.
+void
+SpongeField::clear()
+{
+	for (auto& it : groups_) {
+		it.second.transforms.clear();
+		it.second.dirty = true;
+	}
+}
+
+size_t
+SpongeField::size() const
+{
+	size_t count = 0;
+	for (const auto& it : groups_)
+		count += it.second.transforms.size();
+	return count;
+}
+
+size_t
+SpongeField::groups() const
+{
+	size_t count = 0;
+	for (const auto& it : groups_)
+		if (!it.second.transforms.empty())
+			++count;
+	return count;
+}
+
+void
+SpongeField::update()
+{
+	for (auto& it : groups_) {
+		Group& group = it.second;
+		if (!group.dirty)
+			continue;
+		if (group.vao == 0)
+			create_mesh(it.first, group);
+		CHECK_GL_ERROR(glBindBuffer(GL_ARRAY_BUFFER, group.buffers[kTransformBuffer]));
+		CHECK_GL_ERROR(glBufferData(GL_ARRAY_BUFFER,
+					sizeof(glm::mat4) * group.transforms.size(),
+					group.transforms.data(), GL_STATIC_DRAW));
+		group.dirty = false;
+	}
+}
+
+void
+SpongeField::draw() const
+{
+	for (const auto& it : groups_) {
+		const Group& group = it.second;
+		if (group.transforms.empty())
+			continue;
+		CHECK_GL_ERROR(glBindVertexArray(group.vao));
+		CHECK_GL_ERROR(glDrawElementsInstanced(GL_TRIANGLES, group.index_count,
+					GL_UNSIGNED_INT, 0, group.transforms.size()));
+	}
+}
+
+void
+SpongeField::create_mesh(int level, Group& group)
+{
+	Menger menger;
+	menger.set_nesting_level(level);
+	std::vector<glm::vec4> vertices;
+	std::vector<glm::vec4> normals;
+	std::vector<glm::uvec3> faces;
+	menger.generate_geometry(vertices, normals, faces);
+	group.index_count = faces.size() * 3;
+
+	CHECK_GL_ERROR(glGenVertexArrays(1, &group.vao));
+	CHECK_GL_ERROR(glBindVertexArray(group.vao));
+	CHECK_GL_ERROR(glGenBuffers(4, group.buffers));
+
+	CHECK_GL_ERROR(glBindBuffer(GL_ARRAY_BUFFER, group.buffers[kVertexBuffer]));
+	CHECK_GL_ERROR(glBufferData(GL_ARRAY_BUFFER,
+				sizeof(glm::vec4) * vertices.size(), vertices.data(),
+				GL_STATIC_DRAW));
+	CHECK_GL_ERROR(glVertexAttribPointer(kPositionLocation, 4, GL_FLOAT, GL_FALSE, 0, 0));
+	CHECK_GL_ERROR(glEnableVertexAttribArray(kPositionLocation));
+
+	CHECK_GL_ERROR(glBindBuffer(GL_ARRAY_BUFFER, group.buffers[kNormalBuffer]));
+	CHECK_GL_ERROR(glBufferData(GL_ARRAY_BUFFER,
+				sizeof(glm::vec4) * normals.size(), normals.data(),
+				GL_STATIC_DRAW));
+	CHECK_GL_ERROR(glVertexAttribPointer(kNormalLocation, 4, GL_FLOAT, GL_FALSE, 0, 0));
+	CHECK_GL_ERROR(glEnableVertexAttribArray(kNormalLocation));
+
+	// One column of the instance's transform per location.
+	CHECK_GL_ERROR(glBindBuffer(GL_ARRAY_BUFFER, group.buffers[kTransformBuffer]));
+	for (int column = 0; column < 4; ++column) {
+		GLuint location = kTransformLocation + column;
+		CHECK_GL_ERROR(glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE,
+					sizeof(glm::mat4),
+					reinterpret_cast<const void*>(sizeof(glm::vec4) * column)));
+		CHECK_GL_ERROR(glEnableVertexAttribArray(location));
+		CHECK_GL_ERROR(glVertexAttribDivisor(location, 1));
+	}
+
+	CHECK_GL_ERROR(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, group.buffers[kIndexBuffer]));
+	CHECK_GL_ERROR(glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+				sizeof(glm::uvec3) * faces.size(), faces.data(),
+				GL_STATIC_DRAW));
+}
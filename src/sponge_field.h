@@ -0,0 +1,52 @@
+#ifndef SPONGE_FIELD_H
+#define SPONGE_FIELD_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <map>
+#include <vector>
+
+/*
+ * Any number of sponges, each with its own transform and nesting level.
+ *
+ * Sponges of the same level form a group sharing one mesh, and a group is
+ * drawn with one glDrawElementsInstanced, the transforms coming from a
+ * per-instance mat4 attribute. A frame costs one draw per distinct level,
+ * however many sponges there are.
+ *
+ * Transforms should be rigid plus a uniform scale, the normals are not
+ * corrected for anything else.
+ */
+class SpongeField {
+public:
+	// Attribute locations; the transform takes four, one per column.
+	enum { kPositionLocation, kNormalLocation, kTransformLocation };
+
+	SpongeField();
+	~SpongeField();
+	void add(const glm::mat4& transform, int level);
+	void clear();
+	// Number of sponges.
+	size_t size() const;
+	// Number of distinct levels, i.e. of draw calls.
+	size_t groups() const;
+	// Builds meshes of new levels and uploads changed transforms.
+	void update();
+	// Draws every group with the program in use, binding their own VAOs.
+	void draw() const;
+private:
+	struct Group {
+		GLuint vao = 0;
+		GLuint buffers[4] = { 0, 0, 0, 0 };
+		GLsizei index_count = 0;
+		std::vector<glm::mat4> transforms;
+		bool dirty = true;
+	};
+	enum { kVertexBuffer, kNormalBuffer, kIndexBuffer, kTransformBuffer };
+
+	void create_mesh(int level, Group& group);
+
+	std::map<int, Group> groups_;
+};
+
+#endif